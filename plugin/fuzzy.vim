@@ -64,7 +64,7 @@ function! s:start_fz_job() abort
 
   if executable('fuzzy-search')
     " Ask `fuzzy-search` to list files recursively from repository root
-    let cmd = ['fuzzy-search', '--files', '--search-root=' . l:start_dir, '--jsonrpc', '--results=' . s:results, '--reverse']
+    let cmd = ['fuzzy-search', '--files', '--index', '--watch', '--search-root=' . l:start_dir, '--jsonrpc', '--results=' . s:results, '--reverse']
   else 
     echom "Error: 'fuzzy-search' executable not found in PATH."
   endif
@@ -4,135 +4,458 @@
 #include <cassert>
 #include <ranges>
 
-#include "FuzzySearcher.h"
+namespace
+{
+/// Whether two displays show the same rows.
+bool sameRows(const fzf::Results& a, const fzf::Results& b)
+{
+    return a.totalResults == b.totalResults && a.resultRange == b.resultRange &&
+           std::ranges::equal(a.results, b.results,
+                              [](const fzf::Result& x, const fzf::Result& y)
+                              {
+                                  return x.index == y.index && x.line == y.line &&
+                                         x.selected == y.selected && x.score == y.score;
+                              });
+}
+}  // namespace
 
 Application::Application(std::string& searchString, fzf::Reader::Ptr& inputReader, fzf::InputInterface& tty,
-                         std::size_t numResults)
-    : m_tty(tty), m_searchString(searchString), m_inputReader(inputReader), m_numResults(numResults)
+                         std::size_t numResults, fzf::Scorer scorer, std::size_t cacheBytes,
+                         std::size_t threads, unsigned fps)
+    : m_tty(tty),
+      m_searchString(searchString),
+      m_scorer(scorer),
+      m_query(searchString, scorer),
+      m_inputReader(inputReader),
+      m_numResults(numResults),
+      m_pool(threads),
+      m_ranking(&m_pool, fzf::Ranking::LineStorage::Borrowed),
+      m_cache(cacheBytes),
+      m_ingested(kQueueCapacity),
+      m_scored(kQueueCapacity),
+      m_frameInterval(fps == 0 ? std::chrono::nanoseconds::zero()
+                               : std::chrono::nanoseconds(std::chrono::seconds(1)) / fps)
 {
+    publishQuery();
+    // A generation no search has, so that the first snapshot published is drawn.
+    auto initial = std::make_shared<Snapshot>();
+    initial->generation = ~std::uint64_t{0};
+    m_snapshot = std::move(initial);
+    m_renderThread = std::thread([this]() { renderLoop(); });
     m_inputReader->onUpdate = std::bind_front(&Application::onUpdate, this);
+    m_inputReader->onRemove = std::bind_front(&Application::onRemove, this);
+    m_scoreThread = std::thread([this]() { scoreLoop(); });
+    m_mergeThread = std::thread([this]() { mergeLoop(); });
+    m_searchThread = std::thread([this]() { searchLoop(); });
 }
 
 Application::~Application()
 {
+    {
+        std::scoped_lock lock(m_requestMutex);
+        m_stopSearch = true;
+    }
+    m_searchRequested.notify_one();
+    m_searchThread.join();
+    // Closing the queues first releases a reader blocked on a full pipeline, so that it can be
+    // stopped; stopped before it is disconnected, it cannot notify a listener that is gone.
+    m_ingested.close();
+    m_scored.close();
+    m_inputReader->stop();
     m_inputReader->disconnect();
-    m_inputReader->stop();  // Ensure input reader is stopped
+    m_scoreThread.join();
+    m_mergeThread.join();
+    m_dirty |= kStopRendering;
+    m_dirty.notify_one();
+    m_renderThread.join();
 }
 
 const std::string & Application::result() const
 {
-    if (m_selectedIndex == -1)
+    if (m_requestedIndex != kNoRequest)
     {
-        return m_results[0].first;  // Return first result if no selection
+        // The selection just made is the one wanted.
+        std::unique_lock lock(m_searchMutex);
+        m_searchDone.wait(lock, [this]() { return m_requestedIndex == kNoRequest; });
     }
-    return m_selectedLine;  // Return empty string if no selection
+    // Without a selection this is the first result (see updateSelectedLineIndex)
+    m_result = m_snapshot.load();
+    return m_result->selected;
 }
 
 void Application::updateSpinner(size_t count) { m_tty.updateProgress(count); }
 
-void Application::onUpdate(fzf::Reader::ReadStatus status, const std::string& line)
+void Application::setSearchString(std::string searchString)
+{
+    {
+        std::scoped_lock lock(m_requestMutex);
+        m_searchString = std::move(searchString);
+        ++m_generation;
+    }
+    m_searchRequested.notify_one();
+}
+
+void Application::setSelectedIndex(int index)
+{
+    if (index < 0 || index >= static_cast<int>(size()))
+    {
+        index = -1;  // Reset selection if index is out of bounds
+    }
+    {
+        std::scoped_lock lock(m_requestMutex);
+        m_requestedIndex = index;
+    }
+    m_searchRequested.notify_one();
+}
+
+void Application::applySelection()
+{
+    const int index = m_requestedIndex;
+    if (index == kNoRequest)
+    {
+        return;
+    }
+    // Checked again: the results may have changed since the index was chosen.
+    if (index < 0 || index >= static_cast<int>(m_ranking.matchCount()))
+    {
+        m_selectedIndex = -1;
+        m_selectedId.reset();
+    }
+    else
+    {
+        // Scrolling past the ordered part of the ranking orders the next stretch of it.
+        m_ranking.ensureOrdered(index + m_numResults + navigationMargin());
+        m_selectedIndex = index;
+        m_selectedId = m_ranking.id(index);
+    }
+    publishSnapshot();
+    // getSelectedIndex() reads the request until the snapshot has it; a newer one stays.
+    int applied = index;
+    m_requestedIndex.compare_exchange_strong(applied, kNoRequest);
+    m_searchDone.notify_all();
+}
+
+void Application::waitForSearch()
+{
+    std::unique_lock lock(m_searchMutex);
+    m_searchDone.wait(lock, [this]() { return !isStale(); });
+}
+
+void Application::waitForInput()
+{
+    std::unique_lock lock(m_searchMutex);
+    m_inputApplied.wait(
+        lock, [this]() { return m_deltasApplied == m_deltasIngested && m_pending.empty(); });
+}
+
+void Application::searchLoop()
+{
+    std::uint64_t searched = 0;
+    while (true)
+    {
+        std::optional<std::string> searchString;
+        {
+            std::unique_lock lock(m_requestMutex);
+            m_searchRequested.wait(lock,
+                                   [&]()
+                                   {
+                                       return m_stopSearch || m_generation != searched ||
+                                              m_requestedIndex != kNoRequest;
+                                   });
+            if (m_stopSearch)
+            {
+                return;
+            }
+            if (m_generation != searched)
+            {
+                searchString = m_searchString;
+                searched = m_generation;
+            }
+        }
+        if (searchString)
+        {
+            performFuzzySearch(*searchString, searched);
+        }
+        std::scoped_lock lock(m_searchMutex);
+        applySelection();
+    }
+}
+
+void Application::onUpdate(fzf::Reader::ReadStatus status, fzf::Reader::Batch lines)
+{
+    Delta delta;
+    delta.added.reserve(lines.size());
+    for (const auto& line : lines)
+    {
+        assert(!line.text.empty());
+        delta.added.push_back(fzf::Candidate{line.text, line.mask, 0});
+    }
+    delta.endOfFile = status == fzf::Reader::ReadStatus::EndOfFile;
+    ingest(std::move(delta));
+}
+
+void Application::onRemove(std::span<const std::string_view> lines)
+{
+    Delta delta;
+    delta.removed.assign(lines.begin(), lines.end());
+    ingest(std::move(delta));
+}
+
+void Application::ingest(Delta delta)
+{
+    ++m_deltasIngested;
+    if (!m_ingested.push(std::move(delta)))
+    {
+        --m_deltasIngested;  // Shutting down
+    }
+}
+
+void Application::scoreLoop()
+{
+    while (std::optional<Delta> delta = m_ingested.pop())
+    {
+        std::shared_ptr<const fzf::CompiledQuery> query;
+        {
+            std::scoped_lock lock(m_publishedMutex);
+            query = m_published;
+            delta->generation = m_publishedGeneration;
+        }
+        for (auto& candidate : delta->added)
+        {
+            candidate.score = query->score(candidate.line, candidate.mask);
+        }
+        if (!m_scored.push(std::move(*delta)))
+        {
+            return;
+        }
+    }
+}
+
+void Application::mergeLoop()
 {
-    if (status != fzf::Reader::ReadStatus::EndOfFile)
+    while (true)
     {
-        performIncrementalSearch(line);
+        // While lines are pending, wake up in time to merge them within kMergeInterval.
+        std::optional<std::chrono::steady_clock::duration> timeout;
+        {
+            std::scoped_lock lock(m_searchMutex);
+            if (!m_pending.empty())
+            {
+                timeout = std::max(m_lastMerge + kMergeInterval - std::chrono::steady_clock::now(),
+                                   std::chrono::steady_clock::duration::zero());
+            }
+        }
+        std::optional<Delta> delta = timeout ? m_scored.pop(*timeout) : m_scored.pop();
+        if (!delta && m_scored.closed())
+        {
+            return;
+        }
+
+        bool changed = true;
+        {
+            std::scoped_lock lock(m_searchMutex);
+            if (delta)
+            {
+                changed = apply(*delta);
+                ++m_deltasApplied;
+            }
+            else
+            {
+                mergePending();  // kMergeInterval passed without input
+            }
+            // Published before waitForInput() is woken, so that it sees the lines in the model.
+            if (changed)
+            {
+                updateDisplay();
+            }
+        }
+        m_inputApplied.notify_all();
     }
-    updateDisplay();
+}
+
+bool Application::apply(Delta& delta)
+{
+    if (delta.generation != m_rankedGeneration)
+    {
+        // Scored for a query that has been replaced since.
+        for (auto& candidate : delta.added)
+        {
+            candidate.score = m_query.score(candidate.line, candidate.mask);
+        }
+    }
+    std::move(delta.added.begin(), delta.added.end(), std::back_inserter(m_pending));
+
+    bool changed = false;
+    if (!delta.removed.empty())
+    {
+        mergePending();  // The lines may still be pending
+        std::vector<std::string_view> removed(delta.removed.begin(), delta.removed.end());
+        if (m_ranking.remove(removed) > 0)
+        {
+            if (m_selectedIndex != -1 && m_selectedId && m_ranking.removed(*m_selectedId))
+            {
+                // The selection stays at its index, on the line now there (see updateDisplay).
+                m_selectedId.reset();
+            }
+            else
+            {
+                updateSelectedLineIndex();
+            }
+            changed = true;
+        }
+    }
+    if (delta.endOfFile || m_pending.size() >= kMergeBatchSize ||
+        std::chrono::steady_clock::now() - m_lastMerge >= kMergeInterval)
+    {
+        mergePending();
+        changed = true;
+    }
+    return changed;
+}
+
+void Application::publishQuery()
+{
+    auto query = std::make_shared<const fzf::CompiledQuery>(m_query);
+    std::scoped_lock lock(m_publishedMutex);
+    m_published = std::move(query);
+    m_publishedGeneration = m_rankedGeneration;
 }
 
 void Application::updateDisplay()
 {
-    std::scoped_lock lock(m_searchMutex);
+    mergePending();  // Show everything read so far
+    publishSnapshot();
+}
 
+void Application::publishSnapshot()
+{
     int localSelectedIndex = m_selectedIndex;  // Local copy for thread safety
     if (m_selectedIndex == -1)
     {
         localSelectedIndex = 0;  // Initialize selected index if not set
     }
 
-    // Find last index with non-zero score
-    for (size_t i = m_results.size(); i > 0; --i)
+    // Clamp the selection to the last match, and only display matches
+    int lastEntryIndex = static_cast<int>(m_ranking.matchCount());
+    if (lastEntryIndex > 0)
     {
-        if (m_results[i - 1].second > 0)
-        {
-            localSelectedIndex = std::min(localSelectedIndex, int(i - 1));
-            break;  // Found a valid index
-        }
+        localSelectedIndex = std::min(localSelectedIndex, lastEntryIndex - 1);
     }
 
-    // Determine the range of results to display
-    // Find the first entry with a score of zero or less
-    // This is the last possible entry that should be displayed
-    auto firstZeroEntry = std::find_if(m_results.begin(), m_results.end(),
-                                       [](const auto& result) { return result.second <= 0; });
-    int lastEntryIndex = std::distance(m_results.begin(), firstZeroEntry);
-
     // Start index is the middle of the results list, adjusted for the number of results to display
     size_t start = std::max(0, localSelectedIndex - (m_numResults / 2));
     // Stop index is the minimum of the last entry index and the start index plus the number of
     // results
     size_t stop = std::min(lastEntryIndex, int(start + m_numResults));
+    m_ranking.ensureOrdered(stop);
 
-    fzf::Results displayResults;
-    displayResults.searchString = m_searchString;
+    auto snapshot = std::make_shared<Snapshot>();
+    fzf::Results& displayResults = snapshot->results;
+    displayResults.searchString = m_query.query();
     displayResults.totalResults = lastEntryIndex;
     displayResults.resultRange = {start, stop};
     for (size_t i = start; i < stop; ++i)
     {
-        // Check if the score is zero or less
-        if (m_results[i].second <= 0)
-        {
-            // Skip entries with zero or negative score
-            // Since this list is sorted, we can break early
-            // break;
-        }
-
-        displayResults.results.push_back(fzf::Result(i, m_results[i].first,
+        displayResults.results.push_back(fzf::Result(i, std::string(m_ranking.line(i)),
                                                      (static_cast<int>(i) == localSelectedIndex),
-                                                     m_results[i].second));
+                                                     m_ranking.score(i)));
         if (static_cast<int>(i) == localSelectedIndex)
         {
-            m_selectedLine = m_results[i].first;  // Update selected line
+            m_selectedId = m_ranking.id(i);  // Update selected line
         }
     }
-    m_tty.writeResults(displayResults);
+    snapshot->matches = m_ranking.matchCount();
+    snapshot->selectedIndex = m_selectedIndex;
+    if (m_selectedId)
+    {
+        snapshot->selected = m_ranking.lineById(*m_selectedId);
+    }
+    snapshot->generation = m_rankedGeneration;
+
+    std::shared_ptr<const Snapshot> current = std::move(snapshot);
+    std::shared_ptr<const Snapshot> previous = m_snapshot.exchange(current);
+    const bool changed = current->generation != previous->generation ||
+                         current->selectedIndex != previous->selectedIndex ||
+                         current->selected != previous->selected ||
+                         !sameRows(current->results, previous->results);
+    if (changed && (m_dirty.fetch_or(kDirty) & kDirty) == 0)
+    {
+        m_dirty.notify_one();
+    }
 }
 
-bool resultCompare(const std::pair<std::string, int>& a, const std::pair<std::string, int>& b)
+void Application::renderLoop()
 {
-    if (a.second == b.second)
+    auto nextFrame = std::chrono::steady_clock::now();
+    while (true)
     {
-        return b.first.size() >
-               a.first.size();  // Compare based on the first element (line) if scores are equal
+        m_dirty.wait(0);
+        // Changes made until the frame is due are drawn together.
+        std::this_thread::sleep_until(nextFrame);
+        if (m_dirty.exchange(0) & kStopRendering)
+        {
+            return;
+        }
+        std::shared_ptr<const Snapshot> snapshot = m_snapshot.load();
+        if (snapshot->generation != m_generation)
+        {
+            continue;  // The search for the latest string publishes its results when it completes
+        }
+        m_tty.writeResults(snapshot->results);
+        nextFrame = std::chrono::steady_clock::now() + m_frameInterval;
     }
-    return b.second < a.second;  // Compare based on the second element (score)
 }
 
-void Application::performFuzzySearch()
+bool Application::performFuzzySearch(const std::string& searchString, std::uint64_t generation)
 {
     std::scoped_lock lock(m_searchMutex);
-    // Get lines from input reader;
+    // Lines still pending were scored against the previous query; file them under it first.
+    mergePending();
+
+    // Keep the ranking of the query being left, so that returning to it (e.g. with Backspace)
+    // only has to score the lines read since.
+    // Copying the ranking is skipped when the cache already has it or could not keep it.
+    if (m_cache.wants(m_query.query(), m_ranking.size(),
+                      fzf::Ranking::Snapshot::bytesFor(m_ranking.acceptedCount())))
     {
-        for (auto& line : m_results)
-        {
-            line.second = fzf::score(m_searchString, line.first);
-        }
+        m_cache.put(m_query.query(), m_ranking.snapshot());
     }
 
-    // Sort results based on the score
-    std::ranges::sort(m_results, resultCompare);
+    // Compile the query once and score every line against it, then order only what is shown.
+    // If the new query only adds characters to the previous one, the lines the previous query
+    // rejected cannot match and are skipped.
+    // The pass is abandoned as soon as a newer search string is set, leaving the ranking as it
+    // was for m_query.
+    fzf::CompiledQuery query(searchString, m_scorer);
+    std::size_t visible = std::max(m_selectedIndex, 0) + m_numResults + navigationMargin();
+    auto superseded = [this, generation]() { return m_generation != generation; };
+    if (const auto* cached = m_cache.get(query.query()))
+    {
+        m_ranking.restore(*cached, query, visible);
+    }
+    else if (m_query.isRefinedBy(query) ? !m_ranking.refine(query, visible, superseded)
+                                        : !m_ranking.rescore(query, visible, superseded))
+    {
+        return false;
+    }
+    m_query = std::move(query);
+    m_rankedGeneration = generation;
+    publishQuery();
     updateSelectedLineIndex();  // Update selected line index
+    publishSnapshot();
+    m_searchDone.notify_all();
+    return true;
 }
 
-void Application::performIncrementalSearch(const std::string& line)
+void Application::mergePending()
 {
-    std::scoped_lock lock(m_searchMutex);
-    assert(!line.empty());
-    int score = fzf::score(m_searchString, line);
-
-    // Insert into sorted list
-    auto insertPos = std::ranges::lower_bound(m_results, std::make_pair(line, score));
-    m_results.insert(insertPos, {line, score});
-    std::ranges::sort(m_results, resultCompare);
+    m_lastMerge = std::chrono::steady_clock::now();
+    if (m_pending.empty())
+    {
+        return;
+    }
+    m_ranking.merge(m_pending);
+    m_pending.clear();
     updateSelectedLineIndex();  // Update selected line index
 }
 
@@ -140,10 +463,16 @@ void Application::updateSelectedLineIndex()
 {
     if (m_selectedIndex == -1)
     {
-        return;  // No selection yet
+        // No selection yet: result() is the first result
+        m_ranking.ensureOrdered(1);
+        m_selectedId.reset();
+        if (m_ranking.acceptedCount() > 0)
+        {
+            m_selectedId = m_ranking.id(0);
+        }
+        return;
     }
-    auto it = std::find_if(m_results.begin(), m_results.end(),
-                           [this](const auto& result) { return result.first == m_selectedLine; });
-
-    m_selectedIndex = (it != m_results.end()) ? std::distance(m_results.begin(), it) : 0;
+    // The selected line keeps its Id, whose position the ranking tracks.
+    std::size_t index = m_selectedId ? m_ranking.find(*m_selectedId) : m_ranking.acceptedCount();
+    m_selectedIndex = (index < m_ranking.matchCount()) ? static_cast<int>(index) : 0;
 }
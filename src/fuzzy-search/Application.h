@@ -1,19 +1,57 @@
 #ifndef FUZZY_APPLICATION_H
 #define FUZZY_APPLICATION_H
 
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
 #include <mutex>
+#include <optional>
+#include <span>
 #include <string>
+#include <string_view>
+#include <thread>
 #include <vector>
 
+#include "BoundedQueue.h"
+#include "CompiledQuery.h"
 #include "InputInterface.h"
 #include "ModelInterface.h"
+#include "QueryCache.h"
+#include "Ranking.h"
 #include "Reader.h"
+#include "ThreadPool.h"
 
 /// @class Application
 /// @brief Interactive fuzzy search application for terminal use.
 ///
 /// Handles user input, manages search state, and displays results in the terminal.
 /// Uses a TTY for terminal I/O and a Reader for input data. Thread-safe for concurrent updates.
+///
+/// Searches run on a dedicated thread.  Every search string is tagged with a generation number;
+/// a search still scoring when a newer string arrives is abandoned at the next chunk boundary, and
+/// results are only written to the TTY when they belong to the latest generation.
+///
+/// Input flows through a pipeline of stages connected by BoundedQueues, each on its own thread:
+/// the reader's threads read, split and deduplicate lines (see Reader) and queue them; the score
+/// stage scores them against the latest published query, without holding m_searchMutex; the merge
+/// stage merges them into the ranking and refreshes the display.  A full queue blocks the stage
+/// feeding it, so a reader producing faster than lines can be ranked is slowed down rather than
+/// buffered without bound.  Removals travel the same way, so they apply in order with additions.
+///
+/// Whatever changes the results publishes an immutable Snapshot of them (the rows on screen, the
+/// match count, the selection) through an atomic shared_ptr.  A render thread writes the latest
+/// snapshot to the terminal, and the Controller's reads (size(), getSelectedIndex(), result())
+/// load it, all without m_searchMutex: a slow terminal or JSON-RPC client delays only the render
+/// thread, which then skips the snapshots it had no time for.  setSelectedIndex() only records
+/// the index for the search thread to apply, so key presses are not held up by a search.
+///
+/// Publishing a snapshot that differs from the previous one (rows, selection or query) marks the
+/// display dirty; the render thread redraws the whole of it at most fps times per second, and
+/// only when it is dirty, so a stream of input costs a bounded number of redraws however many
+/// batches it arrives in, and a snapshot that changes nothing costs none.
 class Application : public fzf::ModelInterface
 {
    public:
@@ -30,8 +68,14 @@ class Application : public fzf::ModelInterface
     /// @param inputReader Reference to the input reader function object.
     /// @param tty Reference to the TTY object for terminal interaction.
     /// @param numResults The number of results to return/display.
+    /// @param scorer The scoring algorithm used to rank lines.
+    /// @param cacheBytes Memory budget of the per-query result cache; 0 disables it.
+    /// @param threads Number of threads scoring lines on each keystroke.
+    /// @param fps Maximum number of redraws per second; 0 for no limit.
     Application(std::string& searchString, fzf::Reader::Ptr& inputReader, fzf::InputInterface& tty,
-                std::size_t numResults);
+                std::size_t numResults, fzf::Scorer scorer = fzf::Scorer::SmithWaterman,
+                std::size_t cacheBytes = kDefaultCacheBytes, std::size_t threads = 1,
+                unsigned fps = kDefaultFps);
     /// @brief Destructor. Ensures input reader is stopped.
     ~Application();
 
@@ -43,13 +87,16 @@ class Application : public fzf::ModelInterface
     std::string searchString() const override { return m_searchString; }
 
     /// @brief  Set the search string and update the model.
+    ///
+    /// Returns immediately; the search runs on the search thread and displays its results when
+    /// it completes, unless a newer search string has been set by then.
     /// @param searchString
-    void setSearchString(std::string searchString) override
-    {
-        m_searchString = std::move(searchString);
-        performFuzzySearch();
-        updateDisplay();
-    }
+    void setSearchString(std::string searchString) override;
+
+    /// @brief Wait until the results for the latest search string are in the model.
+    void waitForSearch();
+    /// @brief Wait until every line delivered by the input reader so far is in the model.
+    void waitForInput();
     /// @brief Finish the search and clean up resources.
     void finishSearch()
     {
@@ -57,58 +104,158 @@ class Application : public fzf::ModelInterface
         m_inputReader->disconnect();
     }
 
-    /// @brief Get the currently selected result index.
-    int getSelectedIndex() const override { return m_selectedIndex; }
+    /// @brief Get the currently selected result index, including a selection not applied yet.
+    int getSelectedIndex() const override
+    {
+        const int requested = m_requestedIndex.load();
+        return requested != kNoRequest ? requested : m_snapshot.load()->selectedIndex;
+    }
 
     /// @brief  Set the currently selected result index.
+    ///
+    /// Returns immediately: the index is recorded and applied by the search thread, so that
+    /// moving the selection never waits for a search holding the ranking.
     /// @param index
-    void setSelectedIndex(int index) override
-    {
-        if (index < 0 || index >= static_cast<int>(m_results.size()))
-        {
-            m_selectedIndex = -1;  // Reset selection if index is out of bounds
-            m_selectedLine.clear();
-            return;
-        }
-
-        if (index < static_cast<int>(m_results.size()))
-        {
-            m_selectedIndex = index;
-            m_selectedLine = m_results[index].first;
-        }
-        updateDisplay();
-    }
+    void setSelectedIndex(int index) override;
 
     /// @brief Get the number of results in the model.
-    /// @return The number of results.
-    std::size_t size() const override { return m_results.size(); }
+    /// @return The number of lines matching the search string.
+    std::size_t size() const override { return m_snapshot.load()->matches; }
+
+    /// Default memory budget of the per-query result cache.
+    static constexpr std::size_t kDefaultCacheBytes = 64 << 20;
+    /// Default maximum number of redraws per second.
+    static constexpr unsigned kDefaultFps = 60;
+    /// Number of deltas each pipeline queue holds; with the reader's batches of up to
+    /// Reader::kBatchSize lines, this bounds the lines in flight.
+    static constexpr std::size_t kQueueCapacity = 64;
 
    private:
+    /// @brief Number of rows ordered beyond the visible window, so that moving the selection
+    /// does not need to order more of the ranking on every key press.
+    std::size_t navigationMargin() const { return 2 * m_numResults; }
+
     /// @brief Update the spinner/progress indicator in the terminal.
     /// @param count Number of lines processed or spinner step.
     void updateSpinner(size_t count);
-    /// @brief Handle updates from the input reader.
+    /// @brief Lines added or removed by the input reader, on their way through the pipeline.
+    struct Delta
+    {
+        std::vector<fzf::Candidate> added;  ///< Lines read; scored by the score stage.
+        std::vector<std::string> removed;   ///< Lines taken back.
+        bool endOfFile{false};              ///< Whether the input ended after these lines.
+        std::uint64_t generation{0};        ///< Generation of the query added was scored for.
+    };
+
+    /// @brief Queue the lines read by the input reader for the pipeline; called on its threads.
     /// @param status The read status.
-    /// @param line The new line read.
-    void onUpdate(fzf::Reader::ReadStatus status, const std::string& line);
-    /// @brief Update the terminal display with current results and state.
+    /// @param lines The new lines read.
+    void onUpdate(fzf::Reader::ReadStatus status, fzf::Reader::Batch lines);
+    /// @brief Queue the lines taken back by the input reader for the pipeline.
+    /// @param lines The lines removed.
+    void onRemove(std::span<const std::string_view> lines);
+    /// @brief Queue a delta, waiting while the pipeline is full.
+    void ingest(Delta delta);
+    /// @brief Score stage: score queued lines against the latest published query.
+    void scoreLoop();
+    /// @brief Merge stage: apply scored deltas to the ranking and refresh the display.
+    void mergeLoop();
+    /// @brief Apply a scored delta.  m_searchMutex must be held.
+    ///
+    /// Added lines go to a pending batch, which is merged into the ranking once it holds
+    /// kMergeBatchSize lines or kMergeInterval has passed since the last merge.
+    /// @return true if the ranking changed (and the display should be refreshed).
+    bool apply(Delta& delta);
+    /// @brief Publish m_query to the score stage.  m_searchMutex must be held.
+    void publishQuery();
+    /// @brief What the display shows, as of one change to the results.
+    struct Snapshot
+    {
+        fzf::Results results;          ///< The rows on screen.
+        std::size_t matches{0};        ///< Number of matching lines.
+        int selectedIndex{-1};         ///< m_selectedIndex.
+        std::string selected;          ///< The selected (or first) line, for result().
+        std::uint64_t generation{0};   ///< Generation of the search string results is for.
+    };
+
+    /// @brief Merge the pending lines and publish a snapshot.  m_searchMutex must be held.
     void updateDisplay();
-    /// @brief Perform an incremental search as new lines are read.
-    /// @param line The new line to consider.
-    void performIncrementalSearch(const std::string& line);
+    /// @brief Bits of m_dirty.
+    enum RenderFlag : unsigned
+    {
+        kDirty = 1,          ///< A snapshot not drawn yet differs from the one drawn.
+        kStopRendering = 2,  ///< Tells the render thread to exit.
+    };
+
+    /// @brief Publish a snapshot of the results for the display, and mark the display dirty if
+    /// it differs from the previous one.  m_searchMutex must be held.
+    void publishSnapshot();
+    /// @brief Write the latest snapshot to the terminal when the display is dirty, at most once
+    /// per m_frameInterval, until the destructor stops it.
+    void renderLoop();
+    /// @brief Merge the pending batch into the ranking. m_searchMutex must be held.
+    void mergePending();
+    /// @brief Run the searches requested by setSearchString(), until the destructor stops it.
+    void searchLoop();
     /// @brief Perform a full fuzzy search on all input lines.
-    void performFuzzySearch();
+    /// @param searchString The search string of generation `generation`.
+    /// @param generation The generation of the search.
+    /// @return false if a newer generation was requested before the search completed.
+    bool performFuzzySearch(const std::string& searchString, std::uint64_t generation);
+    /// @brief Whether a search string newer than the ranked one has been set.
+    bool isStale() const { return m_rankedGeneration != m_generation; }
     /// @brief Update the selected line index based on current results.
     void updateSelectedLineIndex();
+    /// @brief Apply the index recorded by setSelectedIndex(), if any, and publish a snapshot.
+    /// m_searchMutex must be held.
+    void applySelection();
+
+    /// m_requestedIndex value when no selection is waiting to be applied.
+    static constexpr int kNoRequest = INT_MIN;
+
+    fzf::InputInterface& m_tty;                   ///< TTY object for terminal interaction.
+    mutable std::mutex m_searchMutex;             ///< Mutex for search operations.
+    /// Signalled when a search completes, or a selection is applied.
+    mutable std::condition_variable m_searchDone;
+    std::mutex m_requestMutex;                    ///< Guards m_searchString and m_stopSearch.
+    std::condition_variable m_searchRequested;    ///< Wakes the search thread.
+    std::atomic<int> m_requestedIndex{kNoRequest};  ///< Selection not applied yet, if any.
+    std::atomic<std::uint64_t> m_generation{0};   ///< Generation of the latest search string.
+    std::uint64_t m_rankedGeneration{0};          ///< Generation of m_query.
+    bool m_stopSearch{false};                     ///< Tells the search thread to exit.
+    std::string& m_searchString;                  ///< The latest search string.
+    fzf::Scorer m_scorer;                         ///< The scoring algorithm.
+    fzf::CompiledQuery m_query;                   ///< The search string m_ranking is scored for.
+    fzf::Reader::Ptr& m_inputReader;              ///< The input reader function object.
+    int m_numResults;                             ///< The number of results to return.
+    int m_selectedIndex{-1};                      ///< The index of the currently selected option.
+    std::optional<fzf::Ranking::Id> m_selectedId;  ///< The selected (or first) line, if any.
+    mutable std::shared_ptr<const Snapshot> m_result;  ///< Keeps result()'s string alive.
+    fzf::ThreadPool m_pool;                       ///< Threads scoring m_ranking.
+    fzf::Ranking m_ranking;  ///< Scored lines, as far as displayed; borrows m_inputReader's text.
+    fzf::QueryCache m_cache;                      ///< Rankings of recent queries.
+    std::vector<fzf::Candidate> m_pending;        ///< Scored lines not yet merged into m_ranking.
+    std::chrono::steady_clock::time_point m_lastMerge{};  ///< Time of the last merge.
+    std::mutex m_publishedMutex;  ///< Guards m_published and m_publishedGeneration.
+    std::shared_ptr<const fzf::CompiledQuery> m_published;  ///< m_query, for the score stage.
+    std::uint64_t m_publishedGeneration{0};  ///< m_rankedGeneration of m_published.
+    fzf::BoundedQueue<Delta> m_ingested;     ///< Reader to score stage.
+    fzf::BoundedQueue<Delta> m_scored;       ///< Score stage to merge stage.
+    std::atomic<std::uint64_t> m_deltasIngested{0};  ///< Deltas queued by the reader.
+    std::uint64_t m_deltasApplied{0};        ///< Deltas applied by the merge stage.
+    std::condition_variable m_inputApplied;  ///< Signalled after each step of the merge stage.
+    std::atomic<std::shared_ptr<const Snapshot>> m_snapshot;  ///< The latest snapshot.
+    std::atomic<unsigned> m_dirty{0};  ///< RenderFlags; waited on by the render thread.
+    std::chrono::nanoseconds m_frameInterval;  ///< Minimum time between redraws.
+    std::thread m_renderThread;  ///< Runs renderLoop().
+    std::thread m_scoreThread;   ///< Runs the score stage.
+    std::thread m_mergeThread;   ///< Runs the merge stage.
+    std::thread m_searchThread;  ///< Runs the searches; started last, joined first.
 
-    fzf::InputInterface& m_tty;       ///< TTY object for terminal interaction.
-    std::mutex m_searchMutex;         ///< Mutex for search operations.
-    std::string& m_searchString;      ///< The search string to use for fuzzy searching.
-    fzf::Reader::Ptr& m_inputReader;  ///< The input reader function object.
-    int m_numResults;                 ///< The number of results to return.
-    int m_selectedIndex{-1};          ///< The index of the currently selected option.
-    std::string m_selectedLine{};     ///< The currently selected line.
-    std::vector<std::pair<std::string, int>> m_results;  ///< Vector of scored lines.
+    /// Maximum number of lines held in m_pending.
+    static constexpr std::size_t kMergeBatchSize = 4096;
+    /// Maximum time lines are held in m_pending while input keeps arriving.
+    static constexpr std::chrono::milliseconds kMergeInterval{50};
 };
 
 #endif  // APPLICATION_H
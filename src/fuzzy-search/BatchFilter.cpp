@@ -0,0 +1,77 @@
+/// @file BatchFilter.cpp
+/// @brief Implementation of the BatchFilter class.
+
+#include "BatchFilter.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <utility>
+
+namespace fzf
+{
+
+BatchFilter::BatchFilter(std::string query, Scorer scorer, std::size_t threads, std::size_t limit)
+    : m_query(std::move(query), scorer),
+      m_limit(limit),
+      m_pool(threads),
+      m_ranking(&m_pool, Ranking::LineStorage::Borrowed)
+{
+}
+
+BatchFilter::Stats BatchFilter::run(Reader& reader, std::ostream& out)
+{
+    const auto started = std::chrono::steady_clock::now();
+    std::mutex mutex;
+    std::condition_variable ended;
+    bool endOfFile = false;
+    // Notifications are serialized by the reader, so the ranking needs no lock of its own.
+    reader.onUpdate = [&](Reader::ReadStatus status, Reader::Batch lines)
+    {
+        for (const auto& line : lines)
+        {
+            m_ranking.append(line.text, line.mask);
+        }
+        if (status == Reader::ReadStatus::EndOfFile)
+        {
+            std::scoped_lock lock(mutex);
+            endOfFile = true;
+            ended.notify_all();
+        }
+    };
+    reader.start();
+    {
+        std::unique_lock lock(mutex);
+        ended.wait(lock, [&]() { return endOfFile; });
+    }
+    reader.stop();
+    reader.disconnect();
+
+    Stats stats;
+    stats.lines = m_ranking.size();
+    const std::size_t visible = std::min(m_limit, m_ranking.size());
+    m_ranking.rescore(m_query, visible);
+    stats.matches = m_ranking.matchCount();
+    stats.printed = std::min(visible, stats.matches);
+    m_ranking.ensureOrdered(stats.printed);
+
+    std::string block;
+    block.reserve(kOutputBlock);
+    for (std::size_t position = 0; position < stats.printed; ++position)
+    {
+        const std::string_view line = m_ranking.line(position);
+        if (block.size() + line.size() + 1 > kOutputBlock && !block.empty())
+        {
+            out.write(block.data(), block.size());
+            block.clear();
+        }
+        block += line;
+        block += '\n';
+    }
+    out.write(block.data(), block.size());
+    out.flush();
+    stats.elapsed = std::chrono::steady_clock::now() - started;
+    return stats;
+}
+
+}  // namespace fzf
@@ -0,0 +1,74 @@
+/// @file BatchFilter.h
+/// @brief Non-interactive search: ranks the whole input against one query and prints the matches.
+
+#ifndef BATCHFILTER_H
+#define BATCHFILTER_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+#include "CompiledQuery.h"
+#include "Ranking.h"
+#include "Reader.h"
+#include "ThreadPool.h"
+
+namespace fzf
+{
+
+/// @class BatchFilter
+/// @brief Reads all of a Reader's input, then prints the lines matching a query, best first (the
+/// equivalent of `fzf --filter`).
+///
+/// No terminal is involved.  Lines are stored unscored as they are read (see Ranking::append()),
+/// borrowed from the reader rather than copied, and scored once the input has ended, in one pass
+/// spread over every thread of the pool; only the printed matches are put in rank order.  The
+/// output is assembled in blocks of kOutputBlock bytes, each handed to the stream with a single
+/// write.
+class BatchFilter
+{
+   public:
+    /// @brief Counts and timings of a run().
+    struct Stats
+    {
+        std::size_t lines{0};    ///< Lines read.
+        std::size_t matches{0};  ///< Lines matching the query.
+        std::size_t printed{0};  ///< Lines printed.
+        std::chrono::duration<double> elapsed{};  ///< From the start of reading to the last write.
+
+        /// @brief Lines read and ranked per second.
+        double linesPerSecond() const
+        {
+            return elapsed.count() > 0 ? lines / elapsed.count() : 0.0;
+        }
+    };
+
+    /// Limit value meaning every match is printed.
+    static constexpr std::size_t kNoLimit = SIZE_MAX;
+    /// Size of the blocks written to the output.
+    static constexpr std::size_t kOutputBlock = 64 * 1024;
+
+    /// @brief Construct a filter.
+    /// @param query The search string.
+    /// @param scorer The scoring algorithm.
+    /// @param threads Number of threads scoring lines.
+    /// @param limit Maximum number of lines printed.
+    BatchFilter(std::string query, Scorer scorer, std::size_t threads, std::size_t limit = kNoLimit);
+
+    /// @brief Read reader's input to its end, then print the matches to out, one per line.
+    ///
+    /// The filter borrows the lines of reader, which must outlive it or the next run().
+    Stats run(Reader& reader, std::ostream& out);
+
+   private:
+    CompiledQuery m_query;  ///< The query.
+    std::size_t m_limit;    ///< Maximum number of lines printed.
+    ThreadPool m_pool;      ///< Threads scoring m_ranking.
+    Ranking m_ranking;      ///< The input, borrowed from the reader of the last run().
+};
+
+}  // namespace fzf
+
+#endif  // BATCHFILTER_H
@@ -0,0 +1,77 @@
+/// @file BlockReader.cpp
+/// @brief Implementation of the BlockReader class.
+
+#include "BlockReader.h"
+
+#include <poll.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+
+namespace fzf
+{
+
+bool BlockReader::wait(const std::atomic<bool>& stop) const
+{
+    pollfd request{m_fd, POLLIN, 0};
+    while (!stop)
+    {
+        int ready = ::poll(&request, 1, kStopInterval);
+        if (ready != 0 && !(ready < 0 && errno == EINTR))
+        {
+            return true;  // Readable, at end of file, or failing: read() tells which
+        }
+    }
+    return false;
+}
+
+bool BlockReader::run(const std::atomic<bool>& stop, const std::function<void(Batch)>& onBatch)
+{
+    std::size_t carried = 0;  // Bytes of an unfinished line at the front of m_buffer
+    while (true)
+    {
+        if (!wait(stop))
+        {
+            return false;
+        }
+        if (carried == m_buffer.size())
+        {
+            m_buffer.resize(2 * m_buffer.size());  // A line longer than the buffer
+        }
+        ssize_t count = ::read(m_fd, m_buffer.data() + carried, m_buffer.size() - carried);
+        if (count < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (count <= 0)
+        {
+            break;
+        }
+
+        const char* begin = m_buffer.data();
+        const char* end = m_buffer.data() + carried + count;
+        m_lines.clear();
+        while (const char* newline =
+                   static_cast<const char*>(std::memchr(begin, '\n', end - begin)))
+        {
+            m_lines.emplace_back(begin, newline - begin);
+            begin = newline + 1;
+        }
+        if (!m_lines.empty())
+        {
+            onBatch(m_lines);
+        }
+        carried = end - begin;
+        std::memmove(m_buffer.data(), begin, carried);
+    }
+
+    if (carried > 0)
+    {
+        const std::string_view last(m_buffer.data(), carried);
+        onBatch(Batch(&last, 1));
+    }
+    return true;
+}
+
+}  // namespace fzf
@@ -0,0 +1,58 @@
+/// @file BlockReader.h
+/// @brief Splits a file descriptor into lines, reading it in large blocks.
+
+#ifndef BLOCKREADER_H
+#define BLOCKREADER_H
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <span>
+#include <string_view>
+#include <vector>
+
+namespace fzf
+{
+
+/// @class BlockReader
+/// @brief Reads a file descriptor with read(2) in kBlockSize blocks and hands out its lines.
+///
+/// Each block is split with memchr and its complete lines are delivered as one batch of views
+/// into the block.  A line cut by the end of a block is moved to the front of the buffer and
+/// completed by the next read; a line longer than the buffer grows it.  The last line does not
+/// need a trailing newline.
+class BlockReader
+{
+   public:
+    /// @brief Lines of one block.  The views are valid until the callback returns.
+    using Batch = std::span<const std::string_view>;
+
+    /// Bytes requested per read(2).
+    static constexpr std::size_t kBlockSize = 1 << 20;
+
+    /// @brief Construct a reader for fd, which it does not own.
+    explicit BlockReader(int fd) : m_fd(fd), m_buffer(kBlockSize) {}
+
+    /// @brief Read until the end of the input, or until stop is set.
+    ///
+    /// While no input is available, stop is polled every kStopInterval.  A read error ends the
+    /// input like the end of the file does.
+    /// @return false if stopped before the end of the input.
+    bool run(const std::atomic<bool>& stop, const std::function<void(Batch)>& onBatch);
+
+   private:
+    /// How often stop is checked while waiting for input, in milliseconds.
+    static constexpr int kStopInterval = 100;
+
+    /// @brief Wait until fd is readable or stop is set.
+    /// @return false if stop was set.
+    bool wait(const std::atomic<bool>& stop) const;
+
+    int m_fd;                             ///< The input.
+    std::vector<char> m_buffer;           ///< Partial line carried over, then the block read.
+    std::vector<std::string_view> m_lines;  ///< Scratch space for a batch.
+};
+
+}  // namespace fzf
+
+#endif  // BLOCKREADER_H
@@ -0,0 +1,150 @@
+/// @file BoundedQueue.h
+/// @brief Bounded single-producer single-consumer queue connecting pipeline stages.
+
+#ifndef BOUNDEDQUEUE_H
+#define BOUNDEDQUEUE_H
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace fzf
+{
+
+/// @class BoundedQueue
+/// @brief A ring buffer of fixed capacity between one producer and one consumer.
+///
+/// push() and pop() are lock-free: the producer only writes the tail index and the consumer only
+/// the head index, each on its own cache line.  A producer finding the ring full, or a consumer
+/// finding it empty, sleeps on an epoch counter (std::atomic::wait) that every push, pop and
+/// close() bumps, so a full ring blocks the producer: that is how backpressure reaches the input.
+/// Several producers may share a queue as long as they are serialized externally (e.g. by the
+/// Reader's notification lock); the same goes for consumers.
+///
+/// After close(), push() fails and pop() drains what is left, then returns nothing.
+template <typename T>
+class BoundedQueue
+{
+   public:
+    /// @brief Construct a queue.
+    /// @param capacity Number of items it holds; rounded up to a power of two.
+    explicit BoundedQueue(std::size_t capacity)
+        : m_slots(std::bit_ceil(std::max<std::size_t>(capacity, 2))), m_mask(m_slots.size() - 1)
+    {
+    }
+
+    BoundedQueue(const BoundedQueue&) = delete;
+    BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+    /// @brief Append an item, waiting while the queue is full.
+    /// @return false if the queue was closed; the item is then dropped.
+    bool push(T item)
+    {
+        const std::uint64_t tail = m_tail.load(std::memory_order_relaxed);
+        while (true)
+        {
+            const std::uint32_t epoch = m_epoch.load(std::memory_order_acquire);
+            if (m_closed.load(std::memory_order_acquire))
+            {
+                return false;
+            }
+            if (tail - m_head.load(std::memory_order_acquire) < m_slots.size())
+            {
+                break;
+            }
+            m_epoch.wait(epoch, std::memory_order_acquire);
+        }
+        m_slots[tail & m_mask] = std::move(item);
+        m_tail.store(tail + 1, std::memory_order_release);
+        signal();
+        return true;
+    }
+
+    /// @brief Remove the oldest item, waiting while the queue is empty and open.
+    /// @return The item, or nothing once the queue is closed and empty.
+    std::optional<T> pop() { return popUntil(std::nullopt); }
+
+    /// @brief Like pop(), but gives up waiting after timeout.
+    /// @return The item, or nothing if the queue is empty after timeout or closed and empty.
+    template <typename Rep, typename Period>
+    std::optional<T> pop(std::chrono::duration<Rep, Period> timeout)
+    {
+        return popUntil(std::chrono::steady_clock::now() + timeout);
+    }
+
+    /// @brief Fail every later push() and wake every waiting producer and consumer.
+    void close()
+    {
+        m_closed.store(true, std::memory_order_release);
+        signal();
+    }
+
+    /// @brief Whether close() was called.
+    bool closed() const { return m_closed.load(std::memory_order_acquire); }
+
+    /// @brief Number of items the queue holds.
+    std::size_t capacity() const { return m_slots.size(); }
+
+   private:
+    /// How long a timed pop() sleeps between looks at the queue.
+    static constexpr std::chrono::microseconds kPollInterval{500};
+
+    std::optional<T> popUntil(std::optional<std::chrono::steady_clock::time_point> deadline)
+    {
+        const std::uint64_t head = m_head.load(std::memory_order_relaxed);
+        while (true)
+        {
+            const std::uint32_t epoch = m_epoch.load(std::memory_order_acquire);
+            if (m_tail.load(std::memory_order_acquire) != head)
+            {
+                break;
+            }
+            if (m_closed.load(std::memory_order_acquire))
+            {
+                return std::nullopt;
+            }
+            if (!deadline)
+            {
+                m_epoch.wait(epoch, std::memory_order_acquire);
+            }
+            else if (std::chrono::steady_clock::now() >= *deadline)
+            {
+                return std::nullopt;
+            }
+            else
+            {
+                // std::atomic::wait has no timeout.
+                std::this_thread::sleep_for(kPollInterval);
+            }
+        }
+        std::optional<T> item(std::move(m_slots[head & m_mask]));
+        m_slots[head & m_mask] = T();
+        m_head.store(head + 1, std::memory_order_release);
+        signal();
+        return item;
+    }
+
+    void signal()
+    {
+        m_epoch.fetch_add(1, std::memory_order_release);
+        m_epoch.notify_all();
+    }
+
+    std::vector<T> m_slots;  ///< The ring.
+    const std::size_t m_mask;  ///< m_slots.size() - 1.
+    alignas(64) std::atomic<std::uint64_t> m_head{0};  ///< Items popped; written by the consumer.
+    alignas(64) std::atomic<std::uint64_t> m_tail{0};  ///< Items pushed; written by the producer.
+    alignas(64) std::atomic<std::uint32_t> m_epoch{0};  ///< Bumped by every change, to wait on.
+    std::atomic<bool> m_closed{false};  ///< Set by close().
+};
+
+}  // namespace fzf
+
+#endif  // BOUNDEDQUEUE_H
@@ -0,0 +1,60 @@
+/// @file CharMask.h
+/// @brief 128-bit "characters present" set used to cheaply reject lines that cannot match.
+
+#ifndef CHARMASK_H
+#define CHARMASK_H
+
+#include <cstdint>
+#include <string_view>
+
+namespace fzf
+{
+
+/// @brief The set of byte values occurring in a string, folded onto 128 bits.
+///
+/// Bytes >= 0x80 share a bit with their ASCII counterpart, so the mask may claim a character is
+/// present when it is not, but never the reverse.  That makes covers() a safe necessary condition
+/// for one string to contain every character of another.
+struct CharMask
+{
+    std::uint64_t low{0};   ///< Bytes 0x00-0x3f.
+    std::uint64_t high{0};  ///< Bytes 0x40-0x7f.
+
+    /// @brief Build the mask of all characters in text.
+    static CharMask fromString(std::string_view text)
+    {
+        CharMask mask;
+        for (char c : text)
+        {
+            mask.add(c);
+        }
+        return mask;
+    }
+
+    /// @brief Add a single character to the set.
+    void add(char c)
+    {
+        auto byte = static_cast<unsigned char>(c);
+        std::uint64_t bit = std::uint64_t{1} << (byte & 63);
+        if (byte & 64)
+        {
+            high |= bit;
+        }
+        else
+        {
+            low |= bit;
+        }
+    }
+
+    /// @brief Whether every character of other is (possibly) present in this set.
+    bool covers(const CharMask& other) const
+    {
+        return ((low & other.low) == other.low) & ((high & other.high) == other.high);
+    }
+
+    bool operator==(const CharMask&) const = default;
+};
+
+}  // namespace fzf
+
+#endif  // CHARMASK_H
@@ -0,0 +1,88 @@
+/// @file CompiledQuery.cpp
+/// @brief Implementation of the CompiledQuery class.
+
+#include "CompiledQuery.h"
+
+#include <stdexcept>
+
+#include "FuzzySearcher.h"
+
+namespace fzf
+{
+
+Scorer parseScorer(const std::string& name)
+{
+    if (name == "smith-waterman")
+    {
+        return Scorer::SmithWaterman;
+    }
+    if (name == "smith-waterman-levenshtein")
+    {
+        return Scorer::SmithWatermanLevenshtein;
+    }
+    throw std::invalid_argument("Unknown scorer: " + name);
+}
+
+CompiledQuery::CompiledQuery(std::string query, Scorer scorer)
+    : m_query(std::move(query)),
+      m_scorer(scorer),
+      m_mask(CharMask::fromString(m_query)),
+      m_profile(m_query),
+      m_kernel(simd::kernel(simd::detectLevel()))
+{
+    if (m_scorer == Scorer::SmithWatermanLevenshtein)
+    {
+        m_levenshtein.assign(m_query);
+    }
+}
+
+namespace
+{
+
+/// Whether needle occurs in haystack as a (not necessarily contiguous) subsequence.
+bool isSubsequence(std::string_view needle, std::string_view haystack)
+{
+    std::size_t pos = 0;
+    for (char c : needle)
+    {
+        pos = haystack.find(c, pos);
+        if (pos == std::string_view::npos)
+        {
+            return false;
+        }
+        ++pos;
+    }
+    return true;
+}
+
+}  // namespace
+
+bool CompiledQuery::accepts(std::string_view line, const CharMask& lineMask) const
+{
+    return lineMask.covers(m_mask) && isSubsequence(m_query, line);
+}
+
+bool CompiledQuery::isRefinedBy(const CompiledQuery& next) const
+{
+    return isSubsequence(m_query, next.m_query);
+}
+
+int CompiledQuery::score(std::string_view line) const
+{
+    if (m_query.empty())
+    {
+        return 1;
+    }
+    const int swScore = m_kernel(m_profile, line);
+    if (m_scorer == Scorer::SmithWatermanLevenshtein)
+    {
+        // Only positive scores are matches, so the distance only needs to be known exactly while
+        // it is below swScore; past that it is cut off at swScore, and the line scores 0: still
+        // accepted, but not a match.  Not kNoMatch, which would leave it out of the lines a longer
+        // query refines, although it may match that query.
+        return swScore - m_levenshtein.distance(line, swScore - 1);
+    }
+    return swScore + orderBonus(m_query, line);
+}
+
+}  // namespace fzf
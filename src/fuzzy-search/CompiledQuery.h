@@ -0,0 +1,102 @@
+/// @file CompiledQuery.h
+/// @brief A search string preprocessed for scoring many lines.
+
+#ifndef COMPILEDQUERY_H
+#define COMPILEDQUERY_H
+
+#include <limits>
+#include <string>
+#include <string_view>
+
+#include "CharMask.h"
+#include "Levenshtein.h"
+#include "SmithWatermanSimd.h"
+
+namespace fzf
+{
+
+/// @brief Scoring algorithms available for ranking lines.
+enum class Scorer
+{
+    SmithWaterman,             ///< Smith-Waterman plus ordering bonus (fzf::score).
+    SmithWatermanLevenshtein   ///< Smith-Waterman minus the Levenshtein distance.
+};
+
+/// @brief Parse a scorer name as given on the command line.
+/// @param name "smith-waterman" or "smith-waterman-levenshtein".
+/// @throws std::invalid_argument for unknown names.
+Scorer parseScorer(const std::string& name);
+
+/// @class CompiledQuery
+/// @brief A search string with everything the scorer derives from it computed up front.
+///
+/// Built once per search string (i.e. once per keystroke) and then used to score every line of
+/// the corpus.  With Scorer::SmithWaterman, score() returns the same value as
+/// fzf::score(query, line).  Matching is case sensitive, so no case-folded form of the query is
+/// kept.
+class CompiledQuery
+{
+   public:
+    /// @brief Compile a search string.
+    /// @param query The search string.
+    /// @param scorer The scoring algorithm.
+    explicit CompiledQuery(std::string query = {}, Scorer scorer = Scorer::SmithWaterman);
+
+    /// @brief The search string this query was compiled from.
+    const std::string& query() const { return m_query; }
+
+    /// @brief Whether the search string is empty (every line matches).
+    bool empty() const { return m_query.empty(); }
+
+    /// @brief The length of the search string.
+    std::size_t size() const { return m_query.size(); }
+
+    /// @brief The set of characters in the search string.
+    const CharMask& mask() const { return m_mask; }
+
+    /// @brief Score given to lines rejected by accepts().  It ranks below every real score.
+    static constexpr int kNoMatch = std::numeric_limits<int>::min();
+
+    /// @brief Whether a line can match at all: it must contain the query's characters in order.
+    ///
+    /// The character mask is checked first, so most lines are rejected without looking at them.
+    /// @param line The line to test.
+    /// @param lineMask CharMask::fromString(line), typically computed when the line was read.
+    bool accepts(std::string_view line, const CharMask& lineMask) const;
+
+    /// @brief Whether every line accepted by next is also accepted by this query, i.e. this query
+    /// is a subsequence of next.  When the user extends the query, only the lines accepted by the
+    /// previous one need to be looked at.
+    bool isRefinedBy(const CompiledQuery& next) const;
+
+    /// @brief Score a line against this query.
+    /// @param line The line to score.
+    /// @return int The score; higher is better.
+    int score(std::string_view line) const;
+
+    /// @brief Score a line whose character mask is already known, rejecting lines that do not
+    /// pass accepts() before running the alignment.
+    /// @param line The line to score.
+    /// @param lineMask CharMask::fromString(line), typically computed when the line was read.
+    /// @return int The score, or kNoMatch.
+    int score(std::string_view line, const CharMask& lineMask) const
+    {
+        if (!accepts(line, lineMask))
+        {
+            return kNoMatch;
+        }
+        return score(line);
+    }
+
+   private:
+    std::string m_query;                  ///< The search string.
+    Scorer m_scorer;                      ///< The scoring algorithm.
+    CharMask m_mask;                      ///< Characters present in the search string.
+    simd::QueryProfile m_profile;         ///< Substitution profile for the Smith-Waterman kernel.
+    simd::SmithWatermanKernel m_kernel;   ///< Kernel selected for the running CPU.
+    LevenshteinPattern m_levenshtein;     ///< Only built for Scorer::SmithWatermanLevenshtein.
+};
+
+}  // namespace fzf
+
+#endif  // COMPILEDQUERY_H
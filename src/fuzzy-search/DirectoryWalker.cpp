@@ -0,0 +1,923 @@
+/// @file DirectoryWalker.cpp
+/// @brief Implementation of the DirectoryWalker class.
+
+#include "DirectoryWalker.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/syscall.h>
+#endif
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <ctime>
+#include <iterator>
+#include <set>
+#include <thread>
+#include <utility>
+
+#include "LineSet.h"
+
+namespace fzf
+{
+
+namespace
+{
+
+/// @brief Call onEntry(name, d_type) for each entry of the open directory fd.
+template <typename OnEntry>
+void forEachEntry(int fd, OnEntry&& onEntry)
+{
+#ifdef SYS_getdents64
+    // The layout the kernel fills in; glibc only wraps getdents64 from version 2.30.
+    struct Entry
+    {
+        ino64_t d_ino;
+        off64_t d_off;
+        unsigned short d_reclen;
+        unsigned char d_type;
+        char d_name[1];
+    };
+    alignas(Entry) char buffer[32 * 1024];
+    while (true)
+    {
+        long count = ::syscall(SYS_getdents64, fd, buffer, sizeof(buffer));
+        if (count <= 0)
+        {
+            return;
+        }
+        for (long offset = 0; offset < count;)
+        {
+            const auto* entry = reinterpret_cast<const Entry*>(buffer + offset);
+            onEntry(entry->d_name, entry->d_type);
+            offset += entry->d_reclen;
+        }
+    }
+#else
+    DIR* dir = ::fdopendir(::dup(fd));
+    if (dir == nullptr)
+    {
+        return;
+    }
+    while (const dirent* entry = ::readdir(dir))
+    {
+        onEntry(entry->d_name, entry->d_type);
+    }
+    ::closedir(dir);
+#endif
+}
+
+/// @brief Contents of the file name in directory fd, or "" if it cannot be read.
+std::string readFile(int fd, const char* name)
+{
+    std::string contents;
+    int file = ::openat(fd, name, O_RDONLY | O_CLOEXEC);
+    if (file < 0)
+    {
+        return contents;
+    }
+    char buffer[16 * 1024];
+    for (ssize_t count; (count = ::read(file, buffer, sizeof(buffer))) > 0;)
+    {
+        contents.append(buffer, count);
+    }
+    ::close(file);
+    return contents;
+}
+
+/// @brief Path of the global excludes file: $XDG_CONFIG_HOME/git/ignore or
+/// $HOME/.config/git/ignore, as git uses when core.excludesFile is not set.
+std::string globalExcludesPath()
+{
+    if (const char* config = std::getenv("XDG_CONFIG_HOME"); config != nullptr && *config != 0)
+    {
+        return std::string(config) + "/git/ignore";
+    }
+    if (const char* home = std::getenv("HOME"); home != nullptr && *home != 0)
+    {
+        return std::string(home) + "/.config/git/ignore";
+    }
+    return {};
+}
+
+/// @brief Stamp of the files with the given paths, relative to the directory fd: the
+/// modification times and sizes of those that exist.  Never FileIndex::kUnknownStamp.
+/// @param newest Raised to the latest modification second among them.
+std::uint64_t stampOf(int fd, std::span<const char* const> paths, std::int64_t& newest)
+{
+    std::string stamp;
+    for (std::size_t i = 0; i < paths.size(); ++i)
+    {
+        struct stat info{};
+        if (::fstatat(fd, paths[i], &info, 0) != 0)
+        {
+            continue;
+        }
+        const std::int64_t fields[] = {static_cast<std::int64_t>(i), info.st_mtim.tv_sec,
+                                       info.st_mtim.tv_nsec,
+                                       static_cast<std::int64_t>(info.st_size)};
+        stamp.append(reinterpret_cast<const char*>(fields), sizeof(fields));
+        newest = std::max<std::int64_t>(newest, info.st_mtim.tv_sec);
+    }
+    return std::max<std::uint64_t>(hashLine(stamp), FileIndex::kUnknownStamp + 1);
+}
+
+/// @brief d_type of the file with the given mode.
+unsigned char typeOf(mode_t mode)
+{
+    return S_ISDIR(mode) ? DT_DIR : S_ISREG(mode) ? DT_REG : DT_UNKNOWN;
+}
+
+}  // namespace
+
+DirectoryWalker::DirectoryWalker(std::string root, Select select, std::size_t threads,
+                                 bool ignoreFiles)
+    : m_root(std::move(root)),
+      m_select(select),
+      m_threads(std::max<std::size_t>(threads, 1)),
+      m_ignoreFiles(ignoreFiles)
+{
+    if (m_ignoreFiles)
+    {
+        IgnoreRules rules;
+        std::vector<std::string> files;
+        if (std::string path = globalExcludesPath(); !path.empty())
+        {
+            rules.parse(readFile(AT_FDCWD, path.c_str()));
+            files.push_back(std::move(path));
+        }
+        if (!rules.empty())
+        {
+            m_rootScope = std::make_shared<const IgnoreScope>(
+                IgnoreScope{nullptr, std::move(rules), prefixLength(m_root), {}});
+        }
+        m_rootScope = ancestorScope(std::move(m_rootScope), files);
+        std::vector<const char*> paths;
+        for (const std::string& file : files)
+        {
+            paths.push_back(file.c_str());
+        }
+        m_rootStamp = stampOf(AT_FDCWD, paths, m_rootNewest);
+    }
+}
+
+std::shared_ptr<const DirectoryWalker::IgnoreScope> DirectoryWalker::ancestorScope(
+    std::shared_ptr<const IgnoreScope> scope, std::vector<std::string>& files) const
+{
+    namespace fs = std::filesystem;
+    std::error_code error;
+    fs::path root = fs::absolute(m_root, error).lexically_normal();
+    if (error)
+    {
+        return scope;
+    }
+    if (root.filename().empty())
+    {
+        root = root.parent_path();  // "dir/" normalizes with a trailing separator
+    }
+    // The root's own files, and a repository at the root, are read by the walk.  Outside a
+    // repository, git reads no ancestor's files.
+    if (fs::exists(root / ".git", error))
+    {
+        return scope;
+    }
+    std::vector<fs::path> ancestors;  // Innermost first, up to the top level
+    bool inRepository = false;
+    for (fs::path directory = root; !inRepository && directory.has_relative_path();)
+    {
+        directory = directory.parent_path();
+        ancestors.push_back(directory);
+        inRepository = fs::exists(directory / ".git", error);
+    }
+    if (!inRepository)
+    {
+        return scope;
+    }
+    for (auto it = ancestors.rbegin(); it != ancestors.rend(); ++it)
+    {
+        IgnoreRules rules;
+        auto parse = [&](const char* name)
+        {
+            files.push_back((*it / name).string());
+            rules.parse(readFile(AT_FDCWD, files.back().c_str()));
+        };
+        if (it == ancestors.rbegin())
+        {
+            parse(".git/info/exclude");
+        }
+        parse(".gitignore");
+        parse(".ignore");
+        if (!rules.empty())
+        {
+            scope = std::make_shared<const IgnoreScope>(
+                IgnoreScope{std::move(scope), std::move(rules), prefixLength(m_root),
+                            root.lexically_relative(*it).string() + "/"});
+        }
+    }
+    return scope;
+}
+
+std::size_t DirectoryWalker::prefixLength(const std::string& directory)
+{
+    return directory.size() + (directory.empty() || directory.back() != '/');
+}
+
+bool DirectoryWalker::isIgnored(const IgnoreScope* scope, std::string_view path, bool isDirectory)
+{
+    // The innermost ignore file with a matching pattern decides.
+    std::string relative;
+    for (; scope != nullptr; scope = scope->parent.get())
+    {
+        std::string_view within = path.substr(scope->baseLength);
+        if (!scope->above.empty())
+        {
+            relative.assign(scope->above).append(within);
+            within = relative;
+        }
+        switch (scope->rules.match(within, isDirectory))
+        {
+            case IgnoreRules::Match::Ignored:
+                return true;
+            case IgnoreRules::Match::Included:
+                return false;
+            case IgnoreRules::Match::None:
+                break;
+        }
+    }
+    return false;
+}
+
+void DirectoryWalker::setIndex(const FileIndex* previous, FileIndex::Writer* next)
+{
+    m_previous = previous;
+    m_next = next;
+}
+
+DirectoryWalker::~DirectoryWalker()
+{
+    if (m_inotify >= 0)
+    {
+        ::close(m_inotify);
+    }
+}
+
+void DirectoryWalker::run(const std::atomic<bool>& stop, const Sink& sink, const Sink& removed)
+{
+    m_started = std::time(nullptr);
+    if (m_next != nullptr)
+    {
+        // Files changed as the walk starts may change again within the same second.
+        m_next->setIgnoreStamp(m_rootNewest >= m_started - 1 ? FileIndex::kUnknownStamp
+                                                             : m_rootStamp);
+    }
+    const bool rescan = m_previous != nullptr && m_previous->ignoreStamp() != m_rootStamp;
+    walk({Directory{m_root, m_rootScope, rescan}}, m_threads, stop, sink, removed);
+}
+
+void DirectoryWalker::walk(std::vector<Directory> directories, std::size_t threadCount,
+                           const std::atomic<bool>& stop, const Sink& sink, const Sink& removed)
+{
+    {
+        std::scoped_lock lock(m_mutex);
+        m_pending = std::move(directories);
+        m_reading = 0;
+    }
+    std::vector<std::thread> threads;
+    for (std::size_t i = 1; i < threadCount; ++i)
+    {
+        threads.emplace_back([&]() { work(stop, sink, removed); });
+    }
+    work(stop, sink, removed);
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+}
+
+void DirectoryWalker::work(const std::atomic<bool>& stop, const Sink& sink, const Sink& removed)
+{
+    Batch batch;
+    std::vector<Directory> subdirectories;
+    while (true)
+    {
+        Directory directory;
+        {
+            std::unique_lock lock(m_mutex);
+            if (m_pending.empty() && m_reading > 0)
+            {
+                // Nothing to read until another thread finds directories: pass on what this one
+                // has found rather than sit on it.
+                lock.unlock();
+                flush(batch, sink);
+                lock.lock();
+            }
+            while (!stop && m_pending.empty() && m_reading > 0)
+            {
+                m_wake.wait_for(lock, kStopInterval);
+            }
+            if (stop || m_pending.empty())
+            {
+                break;  // Stopped, or every directory has been read
+            }
+            // Depth first, which keeps the queue short.
+            directory = std::move(m_pending.back());
+            m_pending.pop_back();
+            ++m_reading;
+        }
+
+        read(directory, batch, subdirectories, stop, sink, removed);
+
+        {
+            std::scoped_lock lock(m_mutex);
+            --m_reading;
+            std::move(subdirectories.begin(), subdirectories.end(), std::back_inserter(m_pending));
+        }
+        subdirectories.clear();
+        m_wake.notify_all();
+    }
+    if (!stop)
+    {
+        flush(batch, sink);
+    }
+    m_wake.notify_all();
+}
+
+std::shared_ptr<const DirectoryWalker::IgnoreScope> DirectoryWalker::scopeOf(
+    int fd, const Directory& directory, bool hasIgnoreFile, bool hasRepository) const
+{
+    if (!m_ignoreFiles || (!hasIgnoreFile && !hasRepository))
+    {
+        return directory.ignore;
+    }
+    // Later files take precedence: .git/info/exclude, then .gitignore, then .ignore.
+    IgnoreRules rules;
+    if (hasRepository)
+    {
+        rules.parse(readFile(fd, ".git/info/exclude"));
+    }
+    if (hasIgnoreFile)
+    {
+        rules.parse(readFile(fd, ".gitignore"));
+        rules.parse(readFile(fd, ".ignore"));
+    }
+    if (rules.empty())
+    {
+        return directory.ignore;
+    }
+    return std::make_shared<const IgnoreScope>(
+        IgnoreScope{directory.ignore, std::move(rules), prefixLength(directory.path), {}});
+}
+
+std::uint64_t DirectoryWalker::ignoreStamp(int fd, std::uint32_t flags, std::int64_t& newest) const
+{
+    // The files scopeOf() reads.  Adding or removing one changes the directory's modification
+    // time, but editing one in place does not.
+    const char* files[3];
+    std::size_t count = 0;
+    if (m_ignoreFiles && (flags & FileIndex::kHasRepository))
+    {
+        files[count++] = ".git/info/exclude";
+    }
+    if (m_ignoreFiles && (flags & FileIndex::kHasIgnoreFile))
+    {
+        files[count++] = ".gitignore";
+        files[count++] = ".ignore";
+    }
+    return stampOf(fd, std::span(files, count), newest);
+}
+
+std::vector<DirectoryWalker::Kept> DirectoryWalker::decode(std::string_view entries)
+{
+    std::vector<Kept> kept;
+    for (std::size_t end; (end = entries.find('\n')) != std::string_view::npos;)
+    {
+        kept.push_back(Kept{std::string(entries.substr(1, end - 1)),
+                            entries[0] != FileIndex::kEntered, entries[0] != FileIndex::kListed});
+        entries.remove_prefix(end + 1);
+    }
+    return kept;
+}
+
+void DirectoryWalker::replay(int fd, int watch, const Directory& directory,
+                             const FileIndex::Directory& cached,
+                             std::vector<Directory>& subdirectories) const
+{
+    std::shared_ptr<const IgnoreScope> scope =
+        scopeOf(fd, directory, cached.flags & FileIndex::kHasIgnoreFile,
+                cached.flags & FileIndex::kHasRepository);
+    std::vector<Kept> kept = decode(cached.entries);
+    std::string path = directory.path;
+    const std::size_t prefix = prefixLength(path);
+    for (const Kept& entry : kept)
+    {
+        if (entry.entered)
+        {
+            path.resize(prefix, '/');
+            path += entry.name;
+            subdirectories.push_back(Directory{path, scope});
+        }
+    }
+    if (m_next != nullptr)
+    {
+        m_next->add(cached);
+    }
+    watched(watch, directory, kept);
+}
+
+std::vector<DirectoryWalker::Kept> DirectoryWalker::list(int fd, const Directory& directory,
+                                                         std::shared_ptr<const IgnoreScope>& scope,
+                                                         std::uint32_t& flags,
+                                                         const std::atomic<bool>& stop) const
+{
+    // Entries are collected first, so that the directory's own ignore files, if it has any,
+    // apply to them without probing for ignore files in every directory.
+    struct Entry
+    {
+        std::string name;
+        unsigned char type;
+    };
+    std::vector<Entry> entries;
+    bool hasIgnoreFile = false;
+    bool hasRepository = false;
+    forEachEntry(fd,
+                 [&](const char* name, unsigned char type)
+                 {
+                     if (std::strcmp(name, ".") != 0 && std::strcmp(name, "..") != 0)
+                     {
+                         hasIgnoreFile |= std::strcmp(name, ".gitignore") == 0 ||
+                                          std::strcmp(name, ".ignore") == 0;
+                         hasRepository |= std::strcmp(name, ".git") == 0;
+                         entries.push_back(Entry{name, type});
+                     }
+                 });
+    flags = (hasIgnoreFile ? FileIndex::kHasIgnoreFile : 0u) |
+            (hasRepository ? FileIndex::kHasRepository : 0u);
+    scope = scopeOf(fd, directory, hasIgnoreFile, hasRepository);
+
+    std::vector<Kept> kept;
+    const std::size_t prefix = prefixLength(directory.path);
+    std::string path = directory.path;
+    for (Entry& entry : entries)
+    {
+        if (stop)
+        {
+            break;
+        }
+        struct stat info{};
+        unsigned char type = entry.type;
+        bool link = type == DT_LNK;
+        if (type == DT_UNKNOWN &&
+            ::fstatat(fd, entry.name.c_str(), &info, AT_SYMLINK_NOFOLLOW) == 0)
+        {
+            link = S_ISLNK(info.st_mode);
+            type = typeOf(info.st_mode);
+        }
+        if (link)
+        {
+            // Listed as what it points to, but not entered.
+            type = ::fstatat(fd, entry.name.c_str(), &info, 0) == 0
+                       ? typeOf(info.st_mode)
+                       : static_cast<unsigned char>(DT_UNKNOWN);
+        }
+        const bool isDirectory = type == DT_DIR;
+        if (isDirectory &&
+            std::find(std::begin(kSkipped), std::end(kSkipped), entry.name) != std::end(kSkipped))
+        {
+            continue;
+        }
+        const bool listed = m_select == Select::Files ? type == DT_REG : isDirectory;
+        const bool entered = isDirectory && !link;
+        if (!listed && !entered)
+        {
+            continue;
+        }
+
+        path.resize(prefix, '/');
+        path += entry.name;
+        if (isIgnored(scope.get(), path, isDirectory))
+        {
+            continue;  // An ignored directory is pruned: never read
+        }
+        kept.push_back(Kept{std::move(entry.name), listed, entered});
+    }
+    return kept;
+}
+
+void DirectoryWalker::listedUnder(const std::string& directory,
+                                  std::vector<std::string>& paths) const
+{
+    std::vector<std::string> directories{directory};
+    while (!directories.empty())
+    {
+        const std::string path = std::move(directories.back());
+        directories.pop_back();
+        const FileIndex::Directory* cached = m_previous->find(path);
+        if (cached == nullptr)
+        {
+            continue;
+        }
+        std::string prefix = path;
+        prefix.resize(prefixLength(path), '/');
+        for (const Kept& entry : decode(cached->entries))
+        {
+            if (entry.listed)
+            {
+                paths.push_back(prefix + entry.name);
+            }
+            if (entry.entered)
+            {
+                directories.push_back(prefix + entry.name);
+            }
+        }
+    }
+}
+
+void DirectoryWalker::read(const Directory& directory, Batch& batch,
+                           std::vector<Directory>& subdirectories, const std::atomic<bool>& stop,
+                           const Sink& sink, const Sink& removed) const
+{
+    // Paths of the index being revalidated that are not kept anymore.
+    std::vector<std::string> gone;
+    auto report = [&]()
+    {
+        if (!gone.empty() && removed && !stop)
+        {
+            std::vector<std::string_view> paths(gone.begin(), gone.end());
+            removed(paths);
+        }
+    };
+
+    int fd = ::openat(AT_FDCWD, directory.path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        // Unreadable or gone: skipped, along with what the index listed under it.
+        if (m_previous != nullptr)
+        {
+            listedUnder(directory.path, gone);
+            report();
+        }
+        return;
+    }
+    // Watched before it is read, so that no change made after the read goes unnoticed.
+    const int watch = addWatch(directory.path);
+
+    // Adding, removing or renaming an entry updates the directory's modification time, so a
+    // directory whose time and ignore files are the ones recorded, below ignore files that did
+    // not change either, lists what the index says it does.
+    struct stat directoryInfo{};
+    const bool dated = (m_previous != nullptr || m_next != nullptr) &&
+                       ::fstat(fd, &directoryInfo) == 0;
+    const FileIndex::Directory* cached =
+        dated && m_previous != nullptr ? m_previous->find(directory.path) : nullptr;
+    std::int64_t newest = 0;
+    if (cached != nullptr && !directory.rescan &&
+        cached->mtimeSeconds == directoryInfo.st_mtim.tv_sec &&
+        cached->mtimeNanoseconds == directoryInfo.st_mtim.tv_nsec &&
+        ignoreStamp(fd, cached->flags, newest) == cached->ignoreStamp)
+    {
+        replay(fd, watch, directory, *cached, subdirectories);
+        ::close(fd);
+        return;
+    }
+
+    std::shared_ptr<const IgnoreScope> scope;
+    std::uint32_t flags = 0;
+    std::vector<Kept> kept = list(fd, directory, scope, flags, stop);
+    newest = 0;
+    const std::uint64_t stamp = dated ? ignoreStamp(fd, flags, newest) : FileIndex::kUnknownStamp;
+    ::close(fd);
+    // What was replayed below it was kept by its old ignore files.
+    const bool rescan = directory.rescan || (cached != nullptr && cached->ignoreStamp != stamp);
+
+    // What the index already lists of a changed directory has been handed to the sink.  Each
+    // entry kept again is cleared from before, which is left with what the index lists or enters
+    // that this read does not.
+    std::vector<Kept> before = cached != nullptr ? decode(cached->entries) : std::vector<Kept>{};
+    std::unordered_map<std::string_view, Kept*> known;
+    for (Kept& entry : before)
+    {
+        known.emplace(entry.name, &entry);
+    }
+
+    std::string recorded;
+    std::string path = directory.path;
+    const std::size_t prefix = prefixLength(path);
+    for (const Kept& entry : kept)
+    {
+        path.resize(prefix, '/');
+        path += entry.name;
+        if (entry.entered)
+        {
+            subdirectories.push_back(Directory{path, scope, rescan});
+        }
+        if (m_next != nullptr && entry.name.find('\n') == std::string::npos)
+        {
+            recorded += !entry.listed   ? FileIndex::kEntered
+                        : entry.entered ? FileIndex::kBoth
+                                        : FileIndex::kListed;
+            recorded += entry.name;
+            recorded += '\n';
+        }
+        Kept* previous = nullptr;
+        if (auto it = known.find(entry.name); it != known.end())
+        {
+            previous = it->second;
+        }
+        const bool wasListed = previous != nullptr && previous->listed;
+        if (previous != nullptr)
+        {
+            previous->listed &= !entry.listed;
+            previous->entered &= !entry.entered;
+        }
+        if (entry.listed && !wasListed)
+        {
+            if (batch.paths.empty())
+            {
+                batch.started = std::chrono::steady_clock::now();
+            }
+            batch.paths.push_back(path);
+            if (batch.paths.size() == kBatchSize)
+            {
+                flush(batch, sink);
+            }
+        }
+    }
+
+    if (m_next != nullptr && dated && !stop)
+    {
+        // A directory or ignore file changed within the second it was read in might change again
+        // without its time moving on coarse-grained file systems; it is recorded so that the
+        // directory is read again.
+        const bool racy = std::max<std::int64_t>(directoryInfo.st_mtim.tv_sec, newest) >=
+                          m_started - 1;
+        m_next->add(FileIndex::Directory{directory.path,
+                                         racy ? -1 : std::int64_t{directoryInfo.st_mtim.tv_sec},
+                                         directoryInfo.st_mtim.tv_nsec, recorded, flags, stamp});
+    }
+    if (!stop)
+    {
+        watched(watch, directory, kept);
+        for (const Kept& entry : before)
+        {
+            path.resize(prefix, '/');
+            path += entry.name;
+            if (entry.listed)
+            {
+                gone.push_back(path);
+            }
+            if (entry.entered)
+            {
+                listedUnder(path, gone);
+            }
+        }
+        report();
+    }
+
+    if (!batch.paths.empty() &&
+        std::chrono::steady_clock::now() - batch.started >= kBatchInterval)
+    {
+        flush(batch, sink);
+    }
+}
+
+bool DirectoryWalker::setWatch(bool watch)
+{
+#ifdef __linux__
+    if (watch && m_inotify < 0)
+    {
+        m_inotify = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    }
+    return !watch || m_inotify >= 0;
+#else
+    return !watch;
+#endif
+}
+
+int DirectoryWalker::addWatch(const std::string& path) const
+{
+#ifdef __linux__
+    if (m_inotify >= 0)
+    {
+        return ::inotify_add_watch(m_inotify, path.c_str(),
+                                   IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO |
+                                       IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR |
+                                       IN_DONT_FOLLOW | IN_EXCL_UNLINK);
+    }
+#endif
+    return -1;
+}
+
+void DirectoryWalker::watched(int watch, const Directory& directory,
+                              const std::vector<Kept>& kept) const
+{
+    if (watch < 0)
+    {
+        return;  // Not watching, or out of watches
+    }
+    std::scoped_lock lock(m_watchMutex);
+    m_watchesByPath[directory.path] = watch;
+    m_watches[watch] = Watch::of(directory, kept);
+}
+
+DirectoryWalker::Watch DirectoryWalker::Watch::of(const Directory& directory,
+                                                  const std::vector<Kept>& kept)
+{
+    Watch watch{directory, {}, {}};
+    for (const Kept& entry : kept)
+    {
+        if (entry.listed)
+        {
+            watch.listed.push_back(entry.name);
+        }
+        if (entry.entered)
+        {
+            watch.entered.push_back(entry.name);
+        }
+    }
+    std::sort(watch.listed.begin(), watch.listed.end());
+    std::sort(watch.entered.begin(), watch.entered.end());
+    return watch;
+}
+
+void DirectoryWalker::watch(const std::atomic<bool>& stop, const Sink& added,
+                            const Sink& removed)
+{
+#ifdef __linux__
+    // Changes are applied to the listing as they are; there is no index to revalidate anymore.
+    m_previous = nullptr;
+    m_next = nullptr;
+    alignas(inotify_event) char buffer[64 * 1024];
+    while (!stop && m_inotify >= 0)
+    {
+        pollfd ready{m_inotify, POLLIN, 0};
+        if (::poll(&ready, 1, static_cast<int>(kStopInterval.count())) <= 0)
+        {
+            continue;
+        }
+        // Every event only marks its directory as changed; each changed directory is then read
+        // once, however many events it had.
+        std::set<int> changed;
+        bool overflowed = false;
+        for (ssize_t count; (count = ::read(m_inotify, buffer, sizeof(buffer))) > 0;)
+        {
+            for (ssize_t offset = 0; offset < count;)
+            {
+                const auto* event = reinterpret_cast<const inotify_event*>(buffer + offset);
+                overflowed |= (event->mask & IN_Q_OVERFLOW) != 0;
+                if (event->wd >= 0)
+                {
+                    changed.insert(event->wd);
+                }
+                offset += sizeof(inotify_event) + event->len;
+            }
+        }
+        if (overflowed)
+        {
+            // Events were lost: every directory watched is read again.
+            std::scoped_lock lock(m_watchMutex);
+            for (const auto& [watch, record] : m_watches)
+            {
+                changed.insert(watch);
+            }
+        }
+
+        Changes changes;
+        for (int watch : changed)
+        {
+            refresh(watch, changes, stop);
+        }
+        if (!changes.removed.empty())
+        {
+            std::vector<std::string_view> paths(changes.removed.begin(), changes.removed.end());
+            removed(paths);
+        }
+        if (!changes.added.empty())
+        {
+            std::vector<std::string_view> paths(changes.added.begin(), changes.added.end());
+            added(paths);
+        }
+        if (!changes.directories.empty())
+        {
+            walk(std::move(changes.directories), 1, stop, added, Sink{});
+        }
+    }
+#else
+    (void)stop, (void)added, (void)removed;
+#endif
+}
+
+void DirectoryWalker::refresh(int watch, Changes& changes, const std::atomic<bool>& stop)
+{
+    Watch before;
+    {
+        std::scoped_lock lock(m_watchMutex);
+        auto it = m_watches.find(watch);
+        if (it == m_watches.end())
+        {
+            return;  // Removed along with an ancestor
+        }
+        before = it->second;
+    }
+    const Directory& directory = before.directory;
+    int fd = ::openat(AT_FDCWD, directory.path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        removeTree(directory.path, changes);
+        return;
+    }
+    // A directory replaced by another of the same name gets a new watch.
+    const int current = addWatch(directory.path);
+    std::shared_ptr<const IgnoreScope> scope;
+    std::uint32_t flags = 0;
+    std::vector<Kept> kept = list(fd, directory, scope, flags, stop);
+    ::close(fd);
+    if (stop)
+    {
+        return;
+    }
+    {
+        std::scoped_lock lock(m_watchMutex);
+        m_watches.erase(watch);
+        m_watchesByPath.erase(directory.path);
+    }
+    watched(current, directory, kept);
+    const Watch after = Watch::of(directory, kept);
+
+    std::string path = directory.path;
+    const std::size_t prefix = prefixLength(path);
+    auto each = [&](const std::vector<std::string>& from, const std::vector<std::string>& without,
+                    auto&& onPath)
+    {
+        std::vector<std::string> names;
+        std::set_difference(from.begin(), from.end(), without.begin(), without.end(),
+                            std::back_inserter(names));
+        for (const std::string& name : names)
+        {
+            path.resize(prefix, '/');
+            path += name;
+            onPath(path);
+        }
+    };
+    each(before.listed, after.listed,
+         [&](const std::string& gone) { changes.removed.push_back(gone); });
+    each(after.listed, before.listed,
+         [&](const std::string& found) { changes.added.push_back(found); });
+    each(before.entered, after.entered,
+         [&](const std::string& gone) { removeTree(gone, changes); });
+    each(after.entered, before.entered,
+         [&](const std::string& found) { changes.directories.push_back(Directory{found, scope}); });
+}
+
+void DirectoryWalker::removeTree(const std::string& path, Changes& changes)
+{
+    std::string below = path;
+    below.resize(prefixLength(path), '/');
+    std::scoped_lock lock(m_watchMutex);
+    auto remove = [&](std::map<std::string, int>::iterator it)
+    {
+        if (auto watch = m_watches.find(it->second); watch != m_watches.end())
+        {
+            std::string prefix = it->first;
+            prefix.resize(prefixLength(it->first), '/');
+            for (const std::string& name : watch->second.listed)
+            {
+                changes.removed.push_back(prefix + name);
+            }
+#ifdef __linux__
+            ::inotify_rm_watch(m_inotify, watch->first);
+#endif
+            m_watches.erase(watch);
+        }
+        return m_watchesByPath.erase(it);
+    };
+    if (auto it = m_watchesByPath.find(path); it != m_watchesByPath.end())
+    {
+        remove(it);
+    }
+    for (auto it = m_watchesByPath.lower_bound(below);
+         it != m_watchesByPath.end() && it->first.starts_with(below);)
+    {
+        it = remove(it);
+    }
+}
+
+void DirectoryWalker::flush(Batch& batch, const Sink& sink)
+{
+    if (batch.paths.empty())
+    {
+        return;
+    }
+    std::vector<std::string_view> paths(batch.paths.begin(), batch.paths.end());
+    sink(paths);
+    batch.paths.clear();
+}
+
+}  // namespace fzf
@@ -0,0 +1,253 @@
+/// @file DirectoryWalker.h
+/// @brief Lists a directory tree with several threads.
+
+#ifndef DIRECTORYWALKER_H
+#define DIRECTORYWALKER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "FileIndex.h"
+#include "IgnoreRules.h"
+
+namespace fzf
+{
+
+/// @class DirectoryWalker
+/// @brief Lists the files or the directories under a root, reading directories in parallel.
+///
+/// Directories still to be read form a shared work queue served by a fixed number of threads, so
+/// that on high-latency file systems (e.g. NFS) many directories are read at once.  Entries are
+/// read in bulk with getdents64 and classified by their d_type; only entries whose type the file
+/// system does not report, and symbolic links, cost a stat.  Symbolic links are listed by what
+/// they point to but never followed.  Directories named in kSkipped (version control metadata) are
+/// neither listed nor entered, and unreadable directories are skipped.
+///
+/// Unless disabled, paths matched by ignore files are left out the way git does: the global
+/// excludes file, .git/info/exclude of repositories found on the way, and the .gitignore and
+/// .ignore files of each directory, which apply to everything below it and take precedence over
+/// those of its ancestors.  When the root is inside a repository, the ignore files of its
+/// ancestors up to the repository's top level, and that repository's .git/info/exclude, apply
+/// too.  Ignored directories are pruned, so they are never read.
+///
+/// Each thread hands the paths it found to the sink in batches of up to kBatchSize, at least
+/// every kBatchInterval, so results stream in while the walk goes on.
+///
+/// Given the index of a previous walk (see setIndex()), the walk revalidates it instead: a
+/// directory whose modification time and ignore files are the ones recorded is not read but
+/// replayed from the index, and only the paths the index does not hold are handed to the sink.
+/// Ignore files apply below their directory, so when those of a directory changed, or those
+/// applying from outside the root did, every directory below is read again too.  The paths the
+/// index holds that the walk no longer lists, those below directories no longer entered included,
+/// are handed to the removed sink.
+///
+/// With watching enabled (see setWatch()), every directory read is also watched with inotify, and
+/// watch() then keeps the listing up to date: each directory in which entries were created,
+/// deleted or moved is read again and compared with what it held, and the paths that appeared or
+/// disappeared are reported, those of new and removed subtrees included.  Edits to an ignore file
+/// apply from the next change to its directory, and only to that directory's own entries.
+/// Directories beyond the inotify watch limit (fs.inotify.max_user_watches) are not watched.
+class DirectoryWalker
+{
+   public:
+    /// @brief What to list.
+    enum class Select
+    {
+        Files,       ///< Regular files.
+        Directories  ///< Directories.
+    };
+
+    /// @brief Receives a batch of paths; called concurrently from the walking threads.  The views
+    /// are valid until it returns.
+    using Sink = std::function<void(std::span<const std::string_view>)>;
+
+    /// Directory names that are not entered.
+    static constexpr std::string_view kSkipped[] = {".git", ".svn", ".hg", ".bzr"};
+    /// Maximum number of paths per batch.
+    static constexpr std::size_t kBatchSize = 1024;
+    /// Maximum time a thread holds paths back while it keeps finding more.
+    static constexpr std::chrono::milliseconds kBatchInterval{50};
+
+    /// @brief Construct a walker.
+    /// @param root The directory to list, which prefixes every path listed.
+    /// @param select What to list.
+    /// @param threads Number of threads reading directories; at least 1.
+    /// @param ignoreFiles Whether to leave out the paths matched by ignore files.
+    DirectoryWalker(std::string root, Select select, std::size_t threads, bool ignoreFiles = true);
+    ~DirectoryWalker();
+
+    /// @brief Revalidate the listing of a previous walk, and record this one.
+    /// @param previous The index of a previous walk of the same root, or nullptr.  It must stay
+    /// valid while run() runs.
+    /// @param next Receives every directory walked, or nullptr.
+    void setIndex(const FileIndex* previous, FileIndex::Writer* next);
+
+    /// @brief Watch the directories read by run(), for watch() to follow.  Set before run().
+    /// @return false if watching is not available (it needs Linux inotify).
+    bool setWatch(bool watch);
+
+    /// @brief List the tree, returning once it has been listed or stop is set.
+    /// @param sink Receives the paths listed (when revalidating, those the index does not hold).
+    /// @param removed Receives the paths the index being revalidated holds that are gone, if set.
+    void run(const std::atomic<bool>& stop, const Sink& sink, const Sink& removed = {});
+
+    /// @brief After run(), report changes to the listing until stop is set.
+    /// @param added Receives the paths that appeared.
+    /// @param removed Receives the paths that disappeared.
+    void watch(const std::atomic<bool>& stop, const Sink& added, const Sink& removed);
+
+   private:
+    /// How often waiting threads check the stop flag.
+    static constexpr std::chrono::milliseconds kStopInterval{100};
+
+    /// @brief The ignore files of one directory, and through parent those of its ancestors.
+    struct IgnoreScope
+    {
+        std::shared_ptr<const IgnoreScope> parent;  ///< Enclosing scope, or nullptr.
+        IgnoreRules rules;                          ///< Patterns of this directory's files.
+        std::size_t baseLength;  ///< Length of this directory's path prefix, '/' included.
+        std::string above;  ///< For an ancestor of the root: the root's path relative to it, '/'
+                            ///< included, which prefixes the paths matched; otherwise empty.
+    };
+
+    /// @brief A directory waiting to be read.
+    struct Directory
+    {
+        std::string path;                           ///< Its path, starting with the root.
+        std::shared_ptr<const IgnoreScope> ignore;  ///< Ignore files applying to its entries.
+        /// Whether ignore files applying to it changed since the index was written, so that it
+        /// is read rather than replayed.
+        bool rescan{false};
+    };
+
+    /// @brief An entry kept by the walk, as classified by list().
+    struct Kept
+    {
+        std::string name;  ///< Its name.
+        bool listed;       ///< Whether it is listed.
+        bool entered;      ///< Whether it is entered.
+    };
+
+    /// @brief What a watched directory held when last read, names sorted.
+    struct Watch
+    {
+        Directory directory;                ///< The directory.
+        std::vector<std::string> listed;   ///< Names of the entries listed.
+        std::vector<std::string> entered;  ///< Names of the subdirectories entered.
+
+        /// @brief The record of directory, given its kept entries.
+        static Watch of(const Directory& directory, const std::vector<Kept>& kept);
+    };
+
+    /// @brief The changes found by watch() in one round of events.
+    struct Changes
+    {
+        std::vector<std::string> added;      ///< Paths that appeared.
+        std::vector<std::string> removed;    ///< Paths that disappeared.
+        std::vector<Directory> directories;  ///< New subdirectories, still to be walked.
+    };
+
+    /// @brief Length of the prefix that directory adds to the paths of its entries.
+    static std::size_t prefixLength(const std::string& directory);
+    /// @brief Whether path is ignored by the ignore files of scope and its ancestors.
+    static bool isIgnored(const IgnoreScope* scope, std::string_view path, bool isDirectory);
+    /// @brief scope, extended with the ignore files of the root's ancestors within its
+    /// repository, outermost first.
+    /// @param files Receives the paths of the files read.
+    std::shared_ptr<const IgnoreScope> ancestorScope(std::shared_ptr<const IgnoreScope> scope,
+                                                     std::vector<std::string>& files) const;
+    /// @brief The FileIndex::Directory::ignoreStamp of the open directory fd, given its
+    /// FileIndex::Directory flags.
+    /// @param newest Raised to the latest modification second of its ignore files.
+    std::uint64_t ignoreStamp(int fd, std::uint32_t flags, std::int64_t& newest) const;
+
+    /// @brief Paths found by one thread and not yet handed to the sink.
+    struct Batch
+    {
+        std::vector<std::string> paths;                    ///< The paths.
+        std::chrono::steady_clock::time_point started{};  ///< When the first path was added.
+    };
+
+    /// @brief The scope of directory's entries, given the ignore files it holds.  fd is the
+    /// directory, open.
+    std::shared_ptr<const IgnoreScope> scopeOf(int fd, const Directory& directory,
+                                               bool hasIgnoreFile, bool hasRepository) const;
+    /// @brief Enter the subdirectories recorded for a directory that has not changed since.
+    void replay(int fd, int watch, const Directory& directory, const FileIndex::Directory& cached,
+                std::vector<Directory>& subdirectories) const;
+
+    /// @brief Start watching path.
+    /// @return The watch descriptor, or -1 if not watching or out of watches.
+    int addWatch(const std::string& path) const;
+    /// @brief Record what the directory with the given watch descriptor (if >= 0) holds.
+    void watched(int watch, const Directory& directory, const std::vector<Kept>& kept) const;
+    /// @brief Read a watched directory again, adding what changed to changes.
+    void refresh(int watch, Changes& changes, const std::atomic<bool>& stop);
+    /// @brief Stop watching path and the directories below it, reporting what they listed as
+    /// removed.
+    void removeTree(const std::string& path, Changes& changes);
+
+    /// @brief The entries of directory kept by the walk: classified, and filtered by kSkipped and
+    /// the ignore files.  fd is the directory, open.
+    /// @param scope Receives the scope of the entries.
+    /// @param flags Receives the FileIndex::Directory flags of the directory.
+    std::vector<Kept> list(int fd, const Directory& directory,
+                           std::shared_ptr<const IgnoreScope>& scope, std::uint32_t& flags,
+                           const std::atomic<bool>& stop) const;
+    /// @brief The entries recorded in a FileIndex::Directory.
+    static std::vector<Kept> decode(std::string_view entries);
+    /// @brief Add to paths every path the previous index lists below directory.
+    void listedUnder(const std::string& directory, std::vector<std::string>& paths) const;
+
+    /// @brief Walk the trees under directories with threadCount threads.
+    void walk(std::vector<Directory> directories, std::size_t threadCount,
+              const std::atomic<bool>& stop, const Sink& sink, const Sink& removed);
+    /// @brief Main loop of a walking thread.
+    void work(const std::atomic<bool>& stop, const Sink& sink, const Sink& removed);
+    /// @brief Read one directory, adding what it lists to batch (flushed to sink when full or
+    /// old) and the subdirectories to enter to subdirectories, and handing what the previous
+    /// index listed of it that is gone to removed.
+    void read(const Directory& directory, Batch& batch, std::vector<Directory>& subdirectories,
+              const std::atomic<bool>& stop, const Sink& sink, const Sink& removed) const;
+    /// @brief Hand the batch to the sink and empty it.
+    static void flush(Batch& batch, const Sink& sink);
+
+    std::string m_root;     ///< The directory listed.
+    Select m_select;        ///< What is listed.
+    std::size_t m_threads;  ///< Number of walking threads.
+    bool m_ignoreFiles;     ///< Whether ignore files are applied.
+    /// Ignore files applying to the root from outside it: the global excludes file and those of
+    /// its ancestors (see ancestorScope()), if any.
+    std::shared_ptr<const IgnoreScope> m_rootScope;
+    std::uint64_t m_rootStamp{FileIndex::kUnknownStamp};  ///< Stamp of m_rootScope's files.
+    std::int64_t m_rootNewest{0};  ///< Latest modification second of m_rootScope's files.
+    const FileIndex* m_previous{nullptr};  ///< The walk being revalidated, if any.
+    FileIndex::Writer* m_next{nullptr};    ///< Records this walk, if set.
+    std::int64_t m_started{0};             ///< Wall-clock second at which run() started.
+    int m_inotify{-1};                     ///< The inotify instance, if watching.
+
+    mutable std::mutex m_watchMutex;                  ///< Guards the watch records.
+    mutable std::unordered_map<int, Watch> m_watches;  ///< Watched directories, by descriptor.
+    mutable std::map<std::string, int> m_watchesByPath;  ///< Descriptors, by path.
+
+    std::mutex m_mutex;                ///< Guards the members below.
+    std::condition_variable m_wake;    ///< Signals new directories or the end of the walk.
+    std::vector<Directory> m_pending;  ///< Directories not read yet.
+    std::size_t m_reading{0};          ///< Directories being read.
+};
+
+}  // namespace fzf
+
+#endif  // DIRECTORYWALKER_H
@@ -0,0 +1,314 @@
+/// @file FileIndex.cpp
+/// @brief Implementation of the FileIndex class.
+
+#include "FileIndex.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <utility>
+
+#include "LineSet.h"
+
+namespace fzf
+{
+
+namespace
+{
+
+constexpr char kMagic[8] = {'F', 'Z', 'F', 'I', 'D', 'X', '\0', '\0'};
+constexpr std::uint32_t kVersion = 2;
+
+/// @brief Start of an index file.
+struct Header
+{
+    char magic[8];                 ///< kMagic.
+    std::uint32_t version;         ///< kVersion.
+    std::uint32_t keyLength;       ///< Length of the key that follows, padded to 8 bytes.
+    std::uint64_t directoryCount;  ///< Number of DirectoryRecords after the key.
+    std::uint64_t dataBytes;       ///< Size of the strings after the DirectoryRecords.
+    std::uint64_t ignoreStamp;     ///< FileIndex::ignoreStamp().
+};
+
+/// @brief A directory in an index file; offsets are into the strings after the DirectoryRecords.
+struct DirectoryRecord
+{
+    std::int64_t mtimeSeconds;
+    std::int64_t mtimeNanoseconds;
+    std::uint64_t ignoreStamp;
+    std::uint64_t pathOffset;
+    std::uint64_t entriesOffset;
+    std::uint32_t pathLength;
+    std::uint32_t entriesLength;
+    std::uint32_t flags;
+    std::uint32_t reserved;
+};
+
+std::size_t padded(std::size_t size) { return (size + 7) & ~std::size_t{7}; }
+
+}  // namespace
+
+void FileIndex::Writer::add(const Directory& directory)
+{
+    Record record{std::string(directory.path), directory.mtimeSeconds, directory.mtimeNanoseconds,
+                  std::string(directory.entries), directory.flags, directory.ignoreStamp};
+    std::scoped_lock lock(m_mutex);
+    m_records.push_back(std::move(record));
+}
+
+void FileIndex::Writer::setIgnoreStamp(std::uint64_t stamp)
+{
+    std::scoped_lock lock(m_mutex);
+    m_ignoreStamp = stamp;
+}
+
+bool FileIndex::Writer::save(const std::string& path, std::string_view key) const
+{
+    std::scoped_lock lock(m_mutex);
+    std::error_code error;
+    std::filesystem::create_directories(std::filesystem::path(path).parent_path(), error);
+
+    Header header{};
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.keyLength = static_cast<std::uint32_t>(key.size());
+    header.directoryCount = m_records.size();
+    header.ignoreStamp = m_ignoreStamp;
+    std::vector<DirectoryRecord> records;
+    records.reserve(m_records.size());
+    std::uint64_t offset = 0;
+    for (const Record& record : m_records)
+    {
+        records.push_back(DirectoryRecord{record.mtimeSeconds, record.mtimeNanoseconds,
+                                          record.ignoreStamp, offset, offset + record.path.size(),
+                                          static_cast<std::uint32_t>(record.path.size()),
+                                          static_cast<std::uint32_t>(record.entries.size()),
+                                          record.flags, 0});
+        offset += record.path.size() + record.entries.size();
+    }
+    header.dataBytes = offset;
+
+    // Written next to the index and renamed over it, so that a reader never maps a partial file.
+    const std::string temporary = path + "." + std::to_string(::getpid()) + ".tmp";
+    {
+        std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+        const char padding[8] = {};
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(key.data(), key.size());
+        out.write(padding, padded(key.size()) - key.size());
+        out.write(reinterpret_cast<const char*>(records.data()),
+                  records.size() * sizeof(DirectoryRecord));
+        for (const Record& record : m_records)
+        {
+            out << record.path << record.entries;
+        }
+        out.flush();
+        if (!out)
+        {
+            std::remove(temporary.c_str());
+            return false;
+        }
+    }
+    if (std::rename(temporary.c_str(), path.c_str()) != 0)
+    {
+        std::remove(temporary.c_str());
+        return false;
+    }
+    return true;
+}
+
+FileIndex::~FileIndex() { unmap(); }
+
+FileIndex::FileIndex(FileIndex&& other) noexcept
+    : m_data(std::exchange(other.m_data, nullptr)),
+      m_size(std::exchange(other.m_size, 0)),
+      m_ignoreStamp(std::exchange(other.m_ignoreStamp, kUnknownStamp)),
+      m_directories(std::move(other.m_directories)),
+      m_byPath(std::move(other.m_byPath))
+{
+}
+
+FileIndex& FileIndex::operator=(FileIndex&& other) noexcept
+{
+    if (this != &other)
+    {
+        unmap();
+        m_data = std::exchange(other.m_data, nullptr);
+        m_size = std::exchange(other.m_size, 0);
+        m_ignoreStamp = std::exchange(other.m_ignoreStamp, kUnknownStamp);
+        m_directories = std::move(other.m_directories);
+        m_byPath = std::move(other.m_byPath);
+    }
+    return *this;
+}
+
+void FileIndex::unmap()
+{
+    if (m_data != nullptr)
+    {
+        ::munmap(const_cast<char*>(m_data), m_size);
+        m_data = nullptr;
+        m_size = 0;
+    }
+    m_ignoreStamp = kUnknownStamp;
+    m_directories.clear();
+    m_byPath.clear();
+}
+
+FileIndex FileIndex::load(const std::string& path, std::string_view key)
+{
+    FileIndex index;
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return index;
+    }
+    struct stat info{};
+    if (::fstat(fd, &info) != 0 || static_cast<std::size_t>(info.st_size) < sizeof(Header))
+    {
+        ::close(fd);
+        return index;
+    }
+    const std::size_t size = info.st_size;
+    void* data = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED)
+    {
+        return index;
+    }
+    index.m_data = static_cast<const char*>(data);
+    index.m_size = size;
+
+    // Everything is checked against the file size before use; an index that does not add up is
+    // dropped rather than trusted.
+    Header header;
+    std::memcpy(&header, index.m_data, sizeof(header));
+    const std::size_t recordsBegin = sizeof(Header) + padded(header.keyLength);
+    if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.version != kVersion ||
+        header.keyLength != key.size() || recordsBegin > size ||
+        std::string_view(index.m_data + sizeof(Header), header.keyLength) != key ||
+        header.directoryCount > (size - recordsBegin) / sizeof(DirectoryRecord) ||
+        header.dataBytes != size - recordsBegin - header.directoryCount * sizeof(DirectoryRecord))
+    {
+        index.unmap();
+        return index;
+    }
+    index.m_ignoreStamp = header.ignoreStamp;
+    const auto* records = reinterpret_cast<const DirectoryRecord*>(index.m_data + recordsBegin);
+    const char* strings = reinterpret_cast<const char*>(records + header.directoryCount);
+    index.m_directories.reserve(header.directoryCount);
+    index.m_byPath.reserve(header.directoryCount);
+    for (std::size_t i = 0; i < header.directoryCount; ++i)
+    {
+        const DirectoryRecord& record = records[i];
+        if (record.pathOffset > header.dataBytes ||
+            record.pathLength > header.dataBytes - record.pathOffset ||
+            record.entriesOffset > header.dataBytes ||
+            record.entriesLength > header.dataBytes - record.entriesOffset)
+        {
+            index.unmap();
+            return index;
+        }
+        Directory directory{std::string_view(strings + record.pathOffset, record.pathLength),
+                            record.mtimeSeconds, record.mtimeNanoseconds,
+                            std::string_view(strings + record.entriesOffset, record.entriesLength),
+                            record.flags, record.ignoreStamp};
+        index.m_byPath.emplace(directory.path, index.m_directories.size());
+        index.m_directories.push_back(directory);
+    }
+    return index;
+}
+
+std::string FileIndex::key(const std::string& root, bool directories, bool ignoreFiles)
+{
+    std::error_code error;
+    std::string absolute = std::filesystem::absolute(root, error).lexically_normal().string();
+    return std::string(directories ? "directories" : "files") +
+           (ignoreFiles ? ":ignore:" : ":all:") + absolute + "\n" + root;
+}
+
+std::string FileIndex::pathFor(std::string_view key)
+{
+    std::string directory;
+    if (const char* cache = std::getenv("XDG_CACHE_HOME"); cache != nullptr && *cache != 0)
+    {
+        directory = cache;
+    }
+    else if (const char* home = std::getenv("HOME"); home != nullptr && *home != 0)
+    {
+        directory = std::string(home) + "/.cache";
+    }
+    else
+    {
+        directory = "/tmp";
+    }
+    char name[17];
+    std::snprintf(name, sizeof(name), "%016llx",
+                  static_cast<unsigned long long>(hashLine(key)));
+    return directory + "/fuzzy-search/" + name + ".index";
+}
+
+const FileIndex::Directory* FileIndex::find(std::string_view path) const
+{
+    auto it = m_byPath.find(path);
+    return it == m_byPath.end() ? nullptr : &m_directories[it->second];
+}
+
+void FileIndex::list(const std::function<void(std::span<const std::string_view>)>& sink,
+                     std::size_t batchSize) const
+{
+    std::string paths;
+    std::vector<std::size_t> ends;
+    std::vector<std::string_view> batch;
+    auto flush = [&]()
+    {
+        batch.clear();
+        for (std::size_t begin = 0, i = 0; i < ends.size(); begin = ends[i++])
+        {
+            batch.emplace_back(paths.data() + begin, ends[i] - begin);
+        }
+        if (!batch.empty())
+        {
+            sink(batch);
+        }
+        paths.clear();
+        ends.clear();
+    };
+    for (const Directory& directory : m_directories)
+    {
+        const bool slash = directory.path.empty() || directory.path.back() != '/';
+        for (std::string_view entries = directory.entries; !entries.empty();)
+        {
+            const std::size_t end = entries.find('\n');
+            if (end == std::string_view::npos)
+            {
+                break;
+            }
+            if (entries[0] != kEntered)
+            {
+                paths += directory.path;
+                if (slash)
+                {
+                    paths += '/';
+                }
+                paths += entries.substr(1, end - 1);
+                ends.push_back(paths.size());
+                if (ends.size() == batchSize)
+                {
+                    flush();
+                }
+            }
+            entries.remove_prefix(end + 1);
+        }
+    }
+    flush();
+}
+
+}  // namespace fzf
@@ -0,0 +1,143 @@
+/// @file FileIndex.h
+/// @brief On-disk index of a directory listing, for showing results before the tree is walked.
+
+#ifndef FILEINDEX_H
+#define FILEINDEX_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace fzf
+{
+
+/// @class FileIndex
+/// @brief The result of a directory walk as saved by FileIndex::Writer, memory-mapped.
+///
+/// For every directory read, the index holds its path, its modification time, a stamp of its
+/// ignore files and what the walk kept of its entries: the names listed and the names of the
+/// subdirectories entered.  A launch with an index first lists everything in it, then walks the
+/// tree again with DirectoryWalker, which only reads the directories whose modification time or
+/// ignore files changed and replays the others from the index.  Adding, removing or renaming an
+/// entry changes the modification time of its directory, and editing an ignore file in place
+/// changes its stamp, so this finds every change to the listing.  The header holds the stamp of
+/// the ignore files applying from outside the root.
+///
+/// The file is a header, the key it was written for (see key()), fixed-size directory records,
+/// then the paths and entries they point to.  A file that is missing, truncated, of another
+/// version or written for another key loads as an empty index.
+class FileIndex
+{
+   public:
+    /// @brief A directory recorded in the index.
+    struct Directory
+    {
+        std::string_view path;          ///< The path walked, starting with the root.
+        std::int64_t mtimeSeconds;      ///< Modification time when it was read.
+        std::int64_t mtimeNanoseconds;  ///< Sub-second part of the modification time.
+        std::string_view entries;       ///< What was kept of its entries; see Writer::add().
+        std::uint32_t flags;            ///< kHasIgnoreFile and kHasRepository.
+        std::uint64_t ignoreStamp;      ///< Modification times and sizes of its ignore files.
+    };
+
+    /// A stamp no ignore files have: recorded when they were changing as the walk read them.
+    static constexpr std::uint64_t kUnknownStamp = 0;
+
+    /// Directory::flags bit: the directory has a .gitignore or .ignore file.
+    static constexpr std::uint32_t kHasIgnoreFile = 1;
+    /// Directory::flags bit: the directory has a .git entry.
+    static constexpr std::uint32_t kHasRepository = 2;
+    /// Entry kinds, the first character of each entry.
+    static constexpr char kListed = 'l';   ///< Listed only.
+    static constexpr char kEntered = 'e';  ///< Entered only.
+    static constexpr char kBoth = 'b';     ///< Listed and entered.
+
+    /// @class Writer
+    /// @brief Collects the directories of a walk and saves them as an index.  Thread-safe.
+    class Writer
+    {
+       public:
+        /// @brief Record a directory.
+        /// @param directory The directory; entries is a sequence of one kind character, a name
+        /// and '\n' per entry kept.
+        void add(const Directory& directory);
+
+        /// @brief Write the index to path, replacing any previous one atomically.
+        /// @return false if it could not be written.
+        bool save(const std::string& path, std::string_view key) const;
+
+        /// @brief Set the stamp of the ignore files applying from outside the root.
+        void setIgnoreStamp(std::uint64_t stamp);
+
+       private:
+        /// @brief A recorded directory, with its strings owned.
+        struct Record
+        {
+            std::string path;               ///< Directory::path.
+            std::int64_t mtimeSeconds;      ///< Directory::mtimeSeconds.
+            std::int64_t mtimeNanoseconds;  ///< Directory::mtimeNanoseconds.
+            std::string entries;            ///< Directory::entries.
+            std::uint32_t flags;            ///< Directory::flags.
+            std::uint64_t ignoreStamp;      ///< Directory::ignoreStamp.
+        };
+
+        mutable std::mutex m_mutex;     ///< Guards the members below.
+        std::vector<Record> m_records;  ///< The directories recorded.
+        std::uint64_t m_ignoreStamp{kUnknownStamp};  ///< See setIgnoreStamp().
+    };
+
+    FileIndex() = default;
+    ~FileIndex();
+    FileIndex(FileIndex&& other) noexcept;
+    FileIndex& operator=(FileIndex&& other) noexcept;
+    FileIndex(const FileIndex&) = delete;
+    FileIndex& operator=(const FileIndex&) = delete;
+
+    /// @brief Map the index at path, if it was written for key.
+    /// @return The index, empty if there is no usable index at path.
+    static FileIndex load(const std::string& path, std::string_view key);
+
+    /// @brief Identifies a walk: what is listed, whether ignore files apply, and the root both as
+    /// given (it prefixes the paths) and as an absolute path.
+    static std::string key(const std::string& root, bool directories, bool ignoreFiles);
+
+    /// @brief Where the index for key is kept: under $XDG_CACHE_HOME/fuzzy-search, or
+    /// ~/.cache/fuzzy-search.
+    static std::string pathFor(std::string_view key);
+
+    /// @brief Whether the index holds no directories.
+    bool empty() const { return m_directories.empty(); }
+
+    /// @brief Number of directories in the index.
+    std::size_t size() const { return m_directories.size(); }
+
+    /// @brief Stamp of the ignore files that applied from outside the root (see
+    /// Writer::setIgnoreStamp()), or kUnknownStamp.
+    std::uint64_t ignoreStamp() const { return m_ignoreStamp; }
+
+    /// @brief The directory recorded for path, or nullptr.
+    const Directory* find(std::string_view path) const;
+
+    /// @brief Hand every listed path of the index to sink, in batches of up to batchSize.
+    void list(const std::function<void(std::span<const std::string_view>)>& sink,
+              std::size_t batchSize) const;
+
+   private:
+    void unmap();
+
+    const char* m_data{nullptr};  ///< The mapped file.
+    std::size_t m_size{0};        ///< Size of the mapping.
+    std::uint64_t m_ignoreStamp{kUnknownStamp};  ///< Returned by ignoreStamp().
+    std::vector<Directory> m_directories;  ///< The directory records, decoded.
+    std::unordered_map<std::string_view, std::size_t> m_byPath;  ///< Index in m_directories.
+};
+
+}  // namespace fzf
+
+#endif  // FILEINDEX_H
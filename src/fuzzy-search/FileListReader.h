@@ -1,8 +1,20 @@
 #include <thread>
 #include <atomic>
+#include "DirectoryWalker.h"
 #include "Reader.h"
 
 namespace fzf {
+/// Lists the files or directories under a root path, reading directories on several threads and
+/// leaving out what .gitignore-style files ignore (see DirectoryWalker).
+///
+/// With an index, the listing saved by the previous run for the same root is listed first, then
+/// revalidated by walking the tree again, reading only the directories that changed since; the
+/// index is then saved for the next run (see FileIndex).  Paths of the index that are gone, or
+/// now ignored, are removed from the listing as the revalidation finds them.
+///
+/// With watching, the reader keeps running after the end of the listing is signalled, adding the
+/// paths created under the root and removing the paths deleted, until it is stopped (see
+/// DirectoryWalker::watch()).
 class FileListReader : public Reader {
 public:
 
@@ -12,8 +24,15 @@ public:
         Directories
     };
 
-    FileListReader(const std::string& rootPath, SearchType searchType)
-        : m_rootPath(rootPath), m_searchType(searchType), m_stopFlag(false) {}
+    /// Default number of threads reading directories.  Listing is bound by the latency of each
+    /// directory read rather than by CPU, so this is more than the usual core count.
+    static constexpr std::size_t kDefaultThreads = 8;
+
+    FileListReader(const std::string& rootPath, SearchType searchType,
+                   std::size_t threads = kDefaultThreads, bool ignoreFiles = true,
+                   bool index = false, bool watch = false)
+        : m_rootPath(rootPath), m_searchType(searchType), m_threads(threads),
+          m_ignoreFiles(ignoreFiles), m_index(index), m_watch(watch), m_stopFlag(false) {}
 
     void start() override {
         m_stopFlag = false;
@@ -31,29 +50,48 @@ public:
 
 private:
     void run() {
-        std::unordered_set<std::string> skipDirs = {".git", ".svn", ".hg", ".bzr"};
-        for (auto it = std::filesystem::recursive_directory_iterator(m_rootPath, std::filesystem::directory_options::skip_permission_denied);
-             it != std::filesystem::recursive_directory_iterator(); ++it) {
-            if (m_stopFlag) break;
-            if (it->is_directory()) {
-                std::string name = it->path().filename().string();
-                if (skipDirs.count(name)) {
-                    it.disable_recursion_pending();
-                    continue;
-                }
-                if (m_searchType == SearchType::Directories) {
-                    addLine(it->path().string());
-                }
-            } else if (m_searchType == SearchType::Files && it->is_regular_file()) {
-                addLine(it->path().string());
-            }
+        DirectoryWalker walker(m_rootPath,
+                               m_searchType == SearchType::Files
+                                   ? DirectoryWalker::Select::Files
+                                   : DirectoryWalker::Select::Directories,
+                               m_threads, m_ignoreFiles);
+        auto sink = [this](std::span<const std::string_view> paths) { addLines(paths); };
+        auto removed = [this](std::span<const std::string_view> paths) { removeLines(paths); };
+        walker.setWatch(m_watch);
+        if (m_index) {
+            runIndexed(walker, sink, removed);
+        } else {
+            walker.run(m_stopFlag, sink);
         }
         setEndOfFile();
+        if (m_watch) {
+            walker.watch(m_stopFlag, sink, removed);
+        }
+    }
+
+    /// Lists the index of the previous run, revalidates it, and saves the new one.
+    void runIndexed(DirectoryWalker& walker, const DirectoryWalker::Sink& sink,
+                    const DirectoryWalker::Sink& removed) {
+        const std::string key = FileIndex::key(
+            m_rootPath, m_searchType == SearchType::Directories, m_ignoreFiles);
+        const std::string path = FileIndex::pathFor(key);
+        FileIndex previous = FileIndex::load(path, key);
+        previous.list(sink, DirectoryWalker::kBatchSize);
+        FileIndex::Writer next;
+        walker.setIndex(&previous, &next);
+        walker.run(m_stopFlag, sink, removed);
+        if (!m_stopFlag) {
+            next.save(path, key);
+        }
     }
 
     std::string m_rootPath;
     SearchType m_searchType;
+    std::size_t m_threads;
+    bool m_ignoreFiles;
+    bool m_index;
+    bool m_watch;
     std::thread m_thread;
     std::atomic<bool> m_stopFlag;
 };
-}
\ No newline at end of file
+}
@@ -1,5 +1,18 @@
 #include "FileReader.h"
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstring>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "BlockReader.h"
+
 namespace fzf
 {
 
@@ -10,24 +23,79 @@ FileReader::FileReader(const std::string& filePath)
     {
         throw std::runtime_error("Invalid file path: " + filePath);
     }
-    m_fileStream.open(filePath);
-    if (!m_fileStream.is_open())
+    m_fd = ::open(filePath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (m_fd < 0)
     {
         throw std::runtime_error("Failed to open file: " + filePath);
     }
+    if (map())
+    {
+        ::close(std::exchange(m_fd, -1));  // The mapping stays valid without the descriptor
+    }
+}
+
+FileReader::~FileReader()
+{
+    if (m_data != nullptr)
+    {
+        ::munmap(const_cast<char*>(m_data), m_size);
+    }
+    if (m_fd >= 0)
+    {
+        ::close(m_fd);
+    }
+}
+
+bool FileReader::map()
+{
+    struct stat info{};
+    void* data = MAP_FAILED;
+    if (::fstat(m_fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0)
+    {
+        data = ::mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, m_fd, 0);
+    }
+    if (data == MAP_FAILED)
+    {
+        return false;
+    }
+    // The file is read once, front to back: read ahead aggressively and drop pages behind.
+    ::madvise(data, info.st_size, MADV_SEQUENTIAL);
+    m_data = static_cast<const char*>(data);
+    m_size = info.st_size;
+    return true;
 }
 
 void FileReader::start()
 {
-    if (!m_fileStream.is_open())
+    if (m_data != nullptr)
     {
-        throw std::runtime_error("File stream is not open.");
+        // memchr is vectorized by the C library, so splitting runs at memory bandwidth.
+        const char* begin = m_data;
+        const char* end = m_data + m_size;
+        std::vector<std::string_view> batch;
+        while (begin < end)
+        {
+            const char* newline = static_cast<const char*>(std::memchr(begin, '\n', end - begin));
+            const char* lineEnd = newline != nullptr ? newline : end;
+            batch.emplace_back(begin, lineEnd - begin);
+            if (batch.size() == kBatchSize)
+            {
+                addLines(batch);
+                batch.clear();
+            }
+            begin = lineEnd + 1;
+        }
+        addLines(batch);
+        setEndOfFile();
+        return;
     }
-    std::string line;
-    while (std::getline(m_fileStream, line))
+
+    if (m_fd < 0)
     {
-        addLine(line);
+        throw std::runtime_error("File is not open.");
     }
+    const std::atomic<bool> never{false};  // Read synchronously, to the end
+    BlockReader(m_fd).run(never, [this](BlockReader::Batch lines) { addLines(lines); });
     setEndOfFile();  // Set end of file status now that reading is done
 }
 
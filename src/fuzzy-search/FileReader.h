@@ -1,6 +1,6 @@
 #pragma once
+#include <cstddef>
 #include <filesystem>
-#include <fstream>
 #include <stdexcept>
 #include <string>
 
@@ -9,19 +9,34 @@
 namespace fzf
 {
 
+/// @class FileReader
+/// @brief Reads the lines of a file.
+///
+/// Regular files are memory-mapped and split in place, so each line is handed to addLines() as a
+/// view into the mapping and only copied by whoever keeps it.  Pipes and other special files,
+/// which cannot be mapped, are read in blocks with a BlockReader.
 class FileReader : public Reader
 {
    public:
     FileReader(const std::string& filePath);
-    ~FileReader() = default;
+    ~FileReader();
+
+    FileReader(const FileReader&) = delete;
+    FileReader& operator=(const FileReader&) = delete;
 
    private:
     void start() override;
 
     bool validateFilePath(const std::string& filePath);
 
-    std::ifstream m_fileStream{};  ///< File stream to read from.
-    std::string m_filePath;      ///< Path to the file to read from.
+    /// @brief Map m_fd if it is a non-empty regular file.
+    /// @return false if it has to be streamed instead.
+    bool map();
+
+    std::string m_filePath;       ///< Path to the file to read from.
+    int m_fd{-1};                 ///< Descriptor to stream from, when not mapped.
+    const char* m_data{nullptr};  ///< The mapped file, if mapped.
+    std::size_t m_size{0};        ///< Size of the mapping.
 };
 
 }  // namespace fzf
@@ -4,76 +4,55 @@
 
 #include "FuzzySearcher.h"
 
-#include <vector>
-#include <algorithm>
+#include "Levenshtein.h"
+#include "SmithWatermanSimd.h"
 
 /// @namespace fzf
 /// @brief Namespace for fuzzy searching utilities.
 namespace fzf
 {
 
-int levenshteinDistance(const std::string& s1, const std::string& s2)
+namespace
 {
-    size_t len1 = s1.size();
-    size_t len2 = s2.size();
-    std::vector<std::vector<int>> dp(len1 + 1, std::vector<int>(len2 + 1));
 
-    for (size_t i = 0; i <= len1; ++i)
+/// The Levenshtein pattern for s1, rebuilt only when s1 changes between calls.
+const LevenshteinPattern& levenshteinPattern(std::string_view s1)
+{
+    thread_local LevenshteinPattern pattern;
+    if (pattern.pattern() != s1)
     {
-        for (size_t j = 0; j <= len2; ++j)
-        {
-            if (i == 0)
-            {
-                dp[i][j] = j;
-            }
-            else if (j == 0)
-            {
-                dp[i][j] = i;
-            }
-            else if (s1[i - 1] == s2[j - 1])
-            {
-                dp[i][j] = dp[i - 1][j - 1];
-            }
-            else
-            {
-                dp[i][j] = 1 + std::min({dp[i - 1][j], dp[i][j - 1], dp[i - 1][j - 1]});
-            }
-        }
+        pattern.assign(s1);
     }
-
-    return dp[len1][len2];
+    return pattern;
 }
 
-/// @brief Calculates the Smith-Waterman similarity score between two strings.
-///
-/// The Smith-Waterman algorithm is used for local sequence alignment. It finds
-/// the optimal alignment between substrings of the input strings.
-///
-/// @param s1 The first string.
-/// @param s2 The second string.
-/// @return The Smith-Waterman similarity score.
-int smithWaterman(const std::string& s1, const std::string& s2)
+}  // namespace
+
+int levenshteinDistance(std::string_view s1, std::string_view s2)
 {
-    size_t len1 = s1.size();
-    size_t len2 = s2.size();
-    std::vector<std::vector<int>> dp(len1 + 1, std::vector<int>(len2 + 1, 0));
+    return levenshteinPattern(s1).distance(s2);
+}
 
-    int maxScore = 0;
+int levenshteinDistanceBounded(std::string_view s1, std::string_view s2, int maxDistance)
+{
+    return levenshteinPattern(s1).distance(s2, maxDistance);
+}
 
-    for (size_t i = 1; i <= len1; ++i)
+int smithWaterman(std::string_view s1, std::string_view s2)
+{
+    // Resolved once, on first use, from the CPU features of the running machine.
+    static const simd::SmithWatermanKernel kernel = simd::kernel(simd::detectLevel());
+    // Callers usually score many lines against the same s1; only rebuild the profile when it
+    // changes.  Hot paths should hold a CompiledQuery instead.
+    thread_local simd::QueryProfile profile;
+    if (profile.query() != s1)
     {
-        for (size_t j = 1; j <= len2; ++j)
-        {
-            int match = (s1[i - 1] == s2[j - 1]) ? 2 : -1;
-            dp[i][j] = std::max({0, dp[i - 1][j - 1] + match, dp[i - 1][j] - 1, dp[i][j - 1] - 1});
-            maxScore = std::max(maxScore, dp[i][j]);
-        }
+        profile.assign(s1);
     }
-
-    return maxScore;
+    return kernel(profile, s2);
 }
 
-int scoreSmithWatermanAndLevenshtein(const std::string& search, const std::string& line)
+int scoreSmithWatermanAndLevenshtein(std::string_view search, std::string_view line)
 {
     // Calculate the Smith-Waterman score
     int swScore = smithWaterman(search, line);
@@ -85,18 +64,10 @@ int scoreSmithWatermanAndLevenshtein(const std::string& search, const std::strin
     return swScore - levDistance;  // Higher is better
 }
 
-int scoreModifiedSmithWaterman(const std::string& search, const std::string& line)
+int orderBonus(std::string_view search, std::string_view line)
 {
-    if (search.empty())
-    {
-        return 1;
-    }
-
-    // This function can be used to calculate a score based on the similarity
-    // between two strings. For now, we will use the Smith-Waterman algorithm.
-    int score = smithWaterman(search, line);
-
-    if (line.find(search) != std::string::npos)
+    int score = 0;
+    if (line.find(search) != std::string_view::npos)
     {
         // If the search string is found in the line, we can boost the score
         score += 10;  // Boost score by 10 for exact matches
@@ -110,7 +81,7 @@ int scoreModifiedSmithWaterman(const std::string& search, const std::string& lin
         for (char c : search)
         {
             pos = line.find(c, pos);
-            if (pos == std::string::npos)
+            if (pos == std::string_view::npos)
             {
                 // If any character is not found, we can reduce the score
                 score -= 5;  // Reduce score by 5 for missing characters
@@ -127,7 +98,19 @@ int scoreModifiedSmithWaterman(const std::string& search, const std::string& lin
     return score;
 }
 
-int score(const std::string& search, const std::string& line)
+int scoreModifiedSmithWaterman(std::string_view search, std::string_view line)
+{
+    if (search.empty())
+    {
+        return 1;
+    }
+
+    // This function can be used to calculate a score based on the similarity
+    // between two strings. For now, we will use the Smith-Waterman algorithm.
+    return smithWaterman(search, line) + orderBonus(search, line);
+}
+
+int score(std::string_view search, std::string_view line)
 {
     // Use the modified Smith-Waterman score for fuzzy searching
     return scoreModifiedSmithWaterman(search, line);
@@ -6,6 +6,7 @@
 #define FUZZYSEARCHER_H
 
 #include <string>
+#include <string_view>
 
 /// @namespace fzf
 /// @brief Namespace for fuzzy searching utilities.
@@ -21,7 +22,16 @@ namespace fzf
 /// @param s1 The first string.
 /// @param s2 The second string.
 /// @return The Levenshtein distance.
-int levenshteinDistance(const std::string& s1, const std::string& s2);
+int levenshteinDistance(std::string_view s1, std::string_view s2);
+
+/// @brief Calculates the Levenshtein distance between two strings, giving up once it is known
+/// to exceed a cutoff.
+///
+/// @param s1 The first string.
+/// @param s2 The second string.
+/// @param maxDistance The largest distance of interest.
+/// @return The Levenshtein distance if it is <= maxDistance, otherwise maxDistance + 1.
+int levenshteinDistanceBounded(std::string_view s1, std::string_view s2, int maxDistance);
 
 /// @brief Calculates the Smith-Waterman similarity score between two strings.
 ///
@@ -31,10 +41,20 @@ int levenshteinDistance(const std::string& s1, const std::string& s2);
 /// @param s1 The first string.
 /// @param s2 The second string.
 /// @return The Smith-Waterman similarity score.
-int smithWaterman(const std::string& s1, const std::string& s2);
+int smithWaterman(std::string_view s1, std::string_view s2);
+
+/// @brief Adjustment applied on top of the Smith-Waterman score by the default scorer.
+///
+/// +10 if search occurs verbatim in line; otherwise +1 for each search character found directly
+/// after the previous one and -5 if the characters do not all occur in order.
+///
+/// @param search The search string (non-empty).
+/// @param line The line being scored.
+/// @return The score adjustment.
+int orderBonus(std::string_view search, std::string_view line);
 
-int score(const std::string& s1, const std::string& s2);
+int score(std::string_view s1, std::string_view s2);
 
 }  // namespace fzf
 
-#endif  // FUZZYSEARCHER_H
\ No newline at end of file
+#endif  // FUZZYSEARCHER_H
@@ -0,0 +1,226 @@
+/// @file IgnoreRules.cpp
+/// @brief Implementation of the IgnoreRules class.
+
+#include "IgnoreRules.h"
+
+namespace fzf
+{
+
+namespace
+{
+constexpr std::string_view kWildcards = "*?[\\";
+
+/// @brief Length of the character class at the start of pattern, brackets included, or 0 if it
+/// is not closed (the '[' is then a literal).  A ']' right after the '[' (or '[!') is part of it.
+std::size_t classLength(std::string_view pattern)
+{
+    std::size_t i = 1;
+    if (i < pattern.size() && (pattern[i] == '!' || pattern[i] == '^'))
+    {
+        ++i;
+    }
+    std::size_t close = pattern.find(']', i + 1);
+    return close == std::string_view::npos ? 0 : close + 1;
+}
+
+/// @brief Whether c is in the class whose contents (between the brackets) are members.
+bool matchClass(std::string_view members, char c)
+{
+    bool negated = !members.empty() && (members[0] == '!' || members[0] == '^');
+    if (negated)
+    {
+        members.remove_prefix(1);
+    }
+    bool matched = false;
+    for (std::size_t i = 0; i < members.size(); ++i)
+    {
+        char low = members[i];
+        char high = low;
+        if (i + 2 < members.size() && members[i + 1] == '-')
+        {
+            high = members[i + 2];
+            i += 2;
+        }
+        matched |= low <= c && c <= high;
+    }
+    return matched != negated;
+}
+
+bool match(std::string_view pattern, std::string_view text, bool segmentStart)
+{
+    while (!pattern.empty())
+    {
+        if (segmentStart && pattern.starts_with("**") &&
+            (pattern.size() == 2 || pattern[2] == '/'))
+        {
+            // Any number of whole segments, including none.
+            if (pattern.size() <= 3)
+            {
+                return true;  // Trailing `**` (or `**/`) matches everything below
+            }
+            std::string_view rest = pattern.substr(3);
+            for (std::size_t i = 0; i <= text.size(); ++i)
+            {
+                if ((i == 0 || text[i - 1] == '/') && match(rest, text.substr(i), true))
+                {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        const char p = pattern[0];
+        if (p == '*')
+        {
+            pattern.remove_prefix(1);
+            for (std::size_t i = 0; i <= text.size(); ++i)
+            {
+                if (match(pattern, text.substr(i), false))
+                {
+                    return true;
+                }
+                if (i < text.size() && text[i] == '/')
+                {
+                    return false;
+                }
+            }
+            return false;
+        }
+        if (text.empty())
+        {
+            return false;
+        }
+        std::size_t length = 0;
+        if (p == '?' || (p == '[' && (length = classLength(pattern)) > 0))
+        {
+            if (text[0] == '/' || (p == '[' && !matchClass(pattern.substr(1, length - 2), text[0])))
+            {
+                return false;
+            }
+            pattern.remove_prefix(p == '?' ? 1 : length);
+        }
+        else
+        {
+            // A literal, possibly escaped, or an unclosed '['.
+            if (p == '\\' && pattern.size() > 1)
+            {
+                pattern.remove_prefix(1);
+            }
+            if (text[0] != pattern[0])
+            {
+                return false;
+            }
+            pattern.remove_prefix(1);
+        }
+        segmentStart = text[0] == '/';
+        text.remove_prefix(1);
+    }
+    return text.empty();
+}
+}  // namespace
+
+bool globMatch(std::string_view pattern, std::string_view text)
+{
+    return match(pattern, text, true);
+}
+
+void IgnoreRules::parse(std::string_view text)
+{
+    while (!text.empty())
+    {
+        std::size_t end = text.find('\n');
+        std::string_view line = text.substr(0, end);
+        text.remove_prefix(end == std::string_view::npos ? text.size() : end + 1);
+
+        if (line.ends_with('\r'))
+        {
+            line.remove_suffix(1);
+        }
+        // Trailing spaces are dropped unless escaped.
+        while (line.ends_with(' ') && !line.ends_with("\\ "))
+        {
+            line.remove_suffix(1);
+        }
+        if (line.empty() || line[0] == '#')
+        {
+            continue;
+        }
+
+        Rule rule{};
+        if (line[0] == '!')
+        {
+            rule.negated = true;
+            line.remove_prefix(1);
+        }
+        else if (line.starts_with("\\!") || line.starts_with("\\#"))
+        {
+            line.remove_prefix(1);
+        }
+        if (line.ends_with('/'))
+        {
+            rule.directoryOnly = true;
+            line.remove_suffix(1);
+        }
+        // A slash anywhere but at the end anchors the pattern to the file's directory.
+        rule.anchored = line.find('/') != std::string_view::npos;
+        if (line.starts_with('/'))
+        {
+            line.remove_prefix(1);
+        }
+        if (line.empty())
+        {
+            continue;
+        }
+
+        rule.pattern = line;
+        if (line.find_first_of(kWildcards) == std::string_view::npos)
+        {
+            rule.kind = Kind::Literal;
+        }
+        else if (!rule.anchored && line[0] == '*' &&
+                 line.find_first_of(kWildcards, 1) == std::string_view::npos)
+        {
+            rule.kind = Kind::Suffix;
+            rule.pattern.erase(0, 1);
+        }
+        else
+        {
+            rule.kind = Kind::Glob;
+        }
+        m_rules.push_back(std::move(rule));
+    }
+}
+
+IgnoreRules::Match IgnoreRules::match(std::string_view path, bool isDirectory) const
+{
+    std::string_view name = path.substr(path.rfind('/') + 1);
+    for (auto it = m_rules.rbegin(); it != m_rules.rend(); ++it)
+    {
+        const Rule& rule = *it;
+        if (rule.directoryOnly && !isDirectory)
+        {
+            continue;
+        }
+        std::string_view subject = rule.anchored ? path : name;
+        bool matched = false;
+        switch (rule.kind)
+        {
+            case Kind::Literal:
+                matched = subject == rule.pattern;
+                break;
+            case Kind::Suffix:
+                matched = subject.ends_with(rule.pattern);
+                break;
+            case Kind::Glob:
+                matched = globMatch(rule.pattern, subject);
+                break;
+        }
+        if (matched)
+        {
+            return rule.negated ? Match::Included : Match::Ignored;
+        }
+    }
+    return Match::None;
+}
+
+}  // namespace fzf
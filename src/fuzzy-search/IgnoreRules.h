@@ -0,0 +1,73 @@
+/// @file IgnoreRules.h
+/// @brief Patterns of a .gitignore-style file, compiled for matching paths during a walk.
+
+#ifndef IGNORERULES_H
+#define IGNORERULES_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace fzf
+{
+
+/// @class IgnoreRules
+/// @brief The patterns of one ignore file (.gitignore, .ignore, .git/info/exclude or the global
+/// excludes file), matched against paths relative to the directory holding it.
+///
+/// Supports the gitignore syntax: comments, `!` negation, a trailing `/` for directories only, a
+/// leading or inner `/` anchoring the pattern to the file's directory, `*`, `?`, `[...]` and `**`.
+/// Patterns are classified when parsed, so that the common forms (plain names such as
+/// `node_modules` and suffixes such as `*.o`) are compared directly instead of going through the
+/// glob matcher.
+class IgnoreRules
+{
+   public:
+    /// @brief Outcome of matching a path.
+    enum class Match
+    {
+        None,     ///< No pattern matches; outer ignore files decide.
+        Ignored,  ///< The last matching pattern ignores it.
+        Included  ///< The last matching pattern is a negation.
+    };
+
+    /// @brief Add the patterns of an ignore file, which take precedence over those already added.
+    void parse(std::string_view text);
+
+    /// @brief Whether there are no patterns.
+    bool empty() const { return m_rules.empty(); }
+
+    /// @brief Match a path.
+    /// @param path The path relative to the ignore file's directory, without a leading '/'.
+    /// @param isDirectory Whether the path is a directory.
+    Match match(std::string_view path, bool isDirectory) const;
+
+   private:
+    /// @brief How a pattern is compared.
+    enum class Kind
+    {
+        Literal,  ///< No wildcards: compared for equality.
+        Suffix,   ///< `*` followed by no wildcards: compared with the end of the name.
+        Glob      ///< Anything else: matched with globMatch().
+    };
+
+    /// @brief One pattern.
+    struct Rule
+    {
+        std::string pattern;         ///< Without `!`, the anchoring `/` and the trailing `/`.
+        Kind kind;                   ///< How pattern is compared.
+        bool negated;                ///< Starts with `!`.
+        bool directoryOnly;          ///< Ends with `/`.
+        bool anchored;               ///< Matched against the whole path rather than the name.
+    };
+
+    std::vector<Rule> m_rules;  ///< In file order; the last match wins.
+};
+
+/// @brief Match text against a gitignore glob: `*` and `?` do not match '/', `**` as a whole path
+/// segment matches any number of segments.
+bool globMatch(std::string_view pattern, std::string_view text);
+
+}  // namespace fzf
+
+#endif  // IGNORERULES_H
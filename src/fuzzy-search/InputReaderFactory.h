@@ -21,6 +21,10 @@ inline Reader::Ptr createInputReader(const po::variables_map& vm,
 {
     // This value is always set because of the default_value in option definition.
     auto searchRoot = vm["search-root"].as<std::string>();
+    std::size_t walkThreads = vm["walk-threads"].as<unsigned>();
+    bool ignoreFiles = vm.count("no-ignore") == 0;
+    bool index = vm.count("index") != 0;
+    bool watch = vm.count("watch") != 0;
 
     if (vm.count("stdin"))
     {
@@ -28,11 +32,15 @@ inline Reader::Ptr createInputReader(const po::variables_map& vm,
     }
     else if (vm.count("directories"))
     {
-        return std::make_unique<FileListReader>(searchRoot, FileListReader::SearchType::Directories);
+        return std::make_unique<FileListReader>(searchRoot, FileListReader::SearchType::Directories,
+                                                walkThreads, ignoreFiles, index,
+                                                watch);
     }
     else if (vm.count("files"))
     {
-        return std::make_unique<FileListReader>(searchRoot, FileListReader::SearchType::Files);
+        return std::make_unique<FileListReader>(searchRoot, FileListReader::SearchType::Files,
+                                                walkThreads, ignoreFiles, index,
+                                                watch);
     }
     else
     {
@@ -0,0 +1,136 @@
+/// @file Levenshtein.cpp
+/// @brief Implementation of the bit-parallel Levenshtein distance.
+
+#include "Levenshtein.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+namespace fzf
+{
+
+namespace
+{
+
+constexpr uint64_t kHighBit = uint64_t{1} << 63;
+
+/// @brief Advance one 64-row block of the edit distance matrix by one text column.
+///
+/// pv/mv hold the positive/negative vertical deltas of the block, eq the pattern bits matching
+/// the text character, hin the horizontal delta entering the top of the block and high the bit
+/// of the block's last row.  Returns the horizontal delta leaving the bottom of the block.
+inline int advanceBlock(uint64_t& pv, uint64_t& mv, uint64_t eq, int hin, uint64_t high)
+{
+    const uint64_t xv = eq | mv;
+    if (hin < 0)
+    {
+        eq |= 1;
+    }
+    const uint64_t xh = (((eq & pv) + pv) ^ pv) | eq;
+    uint64_t ph = mv | ~(xh | pv);
+    uint64_t mh = pv & xh;
+
+    int hout = 0;
+    if (ph & high)
+    {
+        hout = 1;
+    }
+    else if (mh & high)
+    {
+        hout = -1;
+    }
+
+    ph <<= 1;
+    mh <<= 1;
+    if (hin < 0)
+    {
+        mh |= 1;
+    }
+    else if (hin > 0)
+    {
+        ph |= 1;
+    }
+    pv = mh | ~(xv | ph);
+    mv = ph & xv;
+    return hout;
+}
+
+}  // namespace
+
+void LevenshteinPattern::assign(std::string_view pattern)
+{
+    m_pattern.assign(pattern);
+    m_blocks = (pattern.size() + 63) / 64;
+    m_peq.assign(256 * m_blocks, 0);
+    for (std::size_t i = 0; i < pattern.size(); ++i)
+    {
+        auto c = static_cast<unsigned char>(pattern[i]);
+        m_peq[c * m_blocks + i / 64] |= uint64_t{1} << (i % 64);
+    }
+}
+
+int LevenshteinPattern::distance(std::string_view text) const
+{
+    // The distance never exceeds the longer of the two strings, so this bound is never hit.
+    return distance(text, static_cast<int>(std::max(m_pattern.size(), text.size())));
+}
+
+int LevenshteinPattern::distance(std::string_view text, int maxDistance) const
+{
+    const int m = static_cast<int>(m_pattern.size());
+    const int n = static_cast<int>(text.size());
+    const int exceeded = maxDistance + 1;
+
+    // Every insertion or deletion costs one, so the length difference is a lower bound.
+    if (std::abs(m - n) > maxDistance)
+    {
+        return exceeded;
+    }
+    if (m == 0 || n == 0)
+    {
+        return std::max(m, n);
+    }
+
+    // score tracks D[m][j], the distance between the whole pattern and text[0, j).  It changes by
+    // at most one per column, so once score - (columns left) > maxDistance it cannot recover.
+    const uint64_t lastRow = uint64_t{1} << ((m - 1) % 64);
+    int score = m;
+
+    if (m_blocks == 1)
+    {
+        uint64_t pv = ~uint64_t{0};
+        uint64_t mv = 0;
+        for (int j = 0; j < n; ++j)
+        {
+            // Row 0 is D[0][j] = j, so the horizontal delta entering the top is always +1.
+            score += advanceBlock(pv, mv, m_peq[static_cast<unsigned char>(text[j])], 1, lastRow);
+            if (score - (n - j - 1) > maxDistance)
+            {
+                return exceeded;
+            }
+        }
+        return score;
+    }
+
+    thread_local std::vector<uint64_t> pv;
+    thread_local std::vector<uint64_t> mv;
+    pv.assign(m_blocks, ~uint64_t{0});
+    mv.assign(m_blocks, 0);
+    for (int j = 0; j < n; ++j)
+    {
+        const uint64_t* eq = &m_peq[static_cast<unsigned char>(text[j]) * m_blocks];
+        int h = 1;
+        for (std::size_t b = 0; b + 1 < m_blocks; ++b)
+        {
+            h = advanceBlock(pv[b], mv[b], eq[b], h, kHighBit);
+        }
+        score += advanceBlock(pv[m_blocks - 1], mv[m_blocks - 1], eq[m_blocks - 1], h, lastRow);
+        if (score - (n - j - 1) > maxDistance)
+        {
+            return exceeded;
+        }
+    }
+    return score;
+}
+
+}  // namespace fzf
@@ -0,0 +1,52 @@
+/// @file Levenshtein.h
+/// @brief Bit-parallel (Myers/Hyyrö) Levenshtein distance.
+
+#ifndef LEVENSHTEIN_H
+#define LEVENSHTEIN_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace fzf
+{
+
+/// @class LevenshteinPattern
+/// @brief One side of a Levenshtein comparison, preprocessed for Myers' bit-vector algorithm.
+///
+/// The pattern is encoded as one bit per character in 64-bit words (the "Peq" table), so a
+/// column of the edit distance matrix is advanced with a handful of word operations per 64
+/// pattern characters.  Patterns longer than 64 characters use Hyyrö's blocked variant, carrying
+/// the horizontal delta from one word to the next.
+class LevenshteinPattern
+{
+   public:
+    LevenshteinPattern() = default;
+    explicit LevenshteinPattern(std::string_view pattern) { assign(pattern); }
+
+    /// @brief Rebuild for a new pattern, reusing the existing buffers.
+    void assign(std::string_view pattern);
+
+    /// @brief The pattern this object was built from.
+    const std::string& pattern() const { return m_pattern; }
+
+    /// @brief Levenshtein distance between the pattern and text.
+    int distance(std::string_view text) const;
+
+    /// @brief Levenshtein distance between the pattern and text, giving up once it is known to
+    /// exceed maxDistance.
+    /// @param text The text to compare against.
+    /// @param maxDistance The largest distance of interest.
+    /// @return int The distance if it is <= maxDistance, otherwise maxDistance + 1.
+    int distance(std::string_view text, int maxDistance) const;
+
+   private:
+    std::string m_pattern;
+    std::size_t m_blocks{0};      ///< Number of 64-bit words per column.
+    std::vector<uint64_t> m_peq;  ///< 256 x m_blocks: bit i set where pattern[i] == c.
+};
+
+}  // namespace fzf
+
+#endif  // LEVENSHTEIN_H
@@ -0,0 +1,111 @@
+/// @file LineArena.h
+/// @brief Append-only storage for the lines of the corpus.
+
+#ifndef LINEARENA_H
+#define LINEARENA_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+namespace fzf
+{
+
+/// @class LineArena
+/// @brief Lines stored back to back in large character blocks, with an array of line starts.
+///
+/// Compared to one std::string per line this costs 12 bytes per line (its start and length)
+/// instead of a string object plus a heap allocation, and scanning the lines in order is a
+/// linear pass over memory.  Lines are numbered in the order they are appended.
+///
+/// Blocks are never moved or freed before the arena, so a view returned by operator[] stays
+/// valid, at the same address, for as long as the arena lives, and may be read by other threads
+/// while lines are appended (once the append happens-before the read).  This is what lets a
+/// Ranking borrow the lines of a Reader instead of keeping a second copy (see adopt()).  The
+/// arena itself is not thread-safe: the line starts and lengths are vectors that reallocate as
+/// lines are appended, so operator[], length() and size() must not run concurrently with
+/// append() or adopt().
+class LineArena
+{
+   public:
+    LineArena() = default;
+    LineArena(LineArena&&) = default;
+    LineArena& operator=(LineArena&&) = default;
+
+    /// @brief Append a copy of a line.
+    /// @return Its number.
+    std::size_t append(std::string_view line)
+    {
+        if (line.size() > m_free)
+        {
+            // Blocks double in size up to kMaxBlock, so small inputs stay small; a longer line
+            // gets a block of its own.
+            m_blockSize = std::min(m_blockSize * 2, kMaxBlock);
+            const std::size_t size = std::max(m_blockSize, line.size());
+            m_blocks.push_back(std::make_unique_for_overwrite<char[]>(size));
+            m_next = m_blocks.back().get();
+            m_free = size;
+            m_bytes += size;
+        }
+        if (!line.empty())
+        {
+            std::memcpy(m_next, line.data(), line.size());
+        }
+        m_starts.push_back(m_next);
+        m_lengths.push_back(static_cast<std::uint32_t>(line.size()));
+        m_next += line.size();
+        m_free -= line.size();
+        return m_starts.size() - 1;
+    }
+
+    /// @brief Append a line without copying it.
+    /// @param line A line that stays valid, at the same address, as long as the arena is used.
+    /// @return Its number.
+    std::size_t adopt(std::string_view line)
+    {
+        m_starts.push_back(line.data());
+        m_lengths.push_back(static_cast<std::uint32_t>(line.size()));
+        return m_starts.size() - 1;
+    }
+
+    /// @brief The line with the given number.
+    std::string_view operator[](std::size_t index) const
+    {
+        return {m_starts[index], m_lengths[index]};
+    }
+
+    /// @brief Length of the line with the given number.
+    std::size_t length(std::size_t index) const { return m_lengths[index]; }
+
+    /// @brief Number of lines.
+    std::size_t size() const { return m_starts.size(); }
+
+    /// @brief Memory used by the arena, in bytes: the blocks, plus 12 bytes per line.
+    std::size_t bytes() const
+    {
+        return m_bytes + m_starts.capacity() * sizeof(const char*) +
+               m_lengths.capacity() * sizeof(std::uint32_t);
+    }
+
+   private:
+    /// Size of the first block.
+    static constexpr std::size_t kMinBlock = 4 << 10;
+    /// Size the blocks grow to.
+    static constexpr std::size_t kMaxBlock = 1 << 20;
+
+    std::vector<std::unique_ptr<char[]>> m_blocks;  ///< The copied lines, without separators.
+    std::vector<const char*> m_starts;              ///< Start of each line.
+    std::vector<std::uint32_t> m_lengths;           ///< Length of each line.
+    char* m_next{nullptr};                          ///< Where the next copy goes.
+    std::size_t m_free{0};                          ///< Room left after m_next.
+    std::size_t m_blockSize{kMinBlock / 2};         ///< Size of the last block allocated.
+    std::size_t m_bytes{0};                         ///< Total size of m_blocks.
+};
+
+}  // namespace fzf
+
+#endif  // LINEARENA_H
@@ -0,0 +1,190 @@
+/// @file LineSet.cpp
+/// @brief Implementation of the LineSet class.
+
+#include "LineSet.h"
+
+#include <bit>
+#include <cstring>
+
+namespace fzf
+{
+
+namespace
+{
+std::uint64_t mix(std::uint64_t a, std::uint64_t b)
+{
+    __uint128_t product = static_cast<__uint128_t>(a) * b;
+    return static_cast<std::uint64_t>(product) ^ static_cast<std::uint64_t>(product >> 64);
+}
+
+std::uint64_t read64(const char* p)
+{
+    std::uint64_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+std::uint64_t read32(const char* p)
+{
+    std::uint32_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+constexpr std::uint64_t kSecret0 = 0xa0761d6478bd642full;
+constexpr std::uint64_t kSecret1 = 0xe7037ed1a0b428dbull;
+constexpr std::uint64_t kSecret2 = 0x8ebc6af09c88c6e3ull;
+
+/// Slot of a hash in a table of `capacity` slots, from bits not used to pick the shard.
+std::size_t slotOf(std::uint64_t hash, std::size_t capacity) { return hash & (capacity - 1); }
+}  // namespace
+
+std::uint64_t hashLine(std::string_view line)
+{
+    const char* p = line.data();
+    std::size_t n = line.size();
+    std::uint64_t seed = kSecret0 ^ mix(n ^ kSecret1, kSecret2);
+    while (n > 16)
+    {
+        seed = mix(read64(p) ^ kSecret1, read64(p + 8) ^ seed);
+        p += 16;
+        n -= 16;
+    }
+    std::uint64_t a = 0;
+    std::uint64_t b = 0;
+    if (n >= 8)
+    {
+        a = read64(p);
+        b = read64(p + n - 8);
+    }
+    else if (n >= 4)
+    {
+        a = read32(p);
+        b = read32(p + n - 4);
+    }
+    else if (n > 0)
+    {
+        a = (static_cast<std::uint64_t>(static_cast<unsigned char>(p[0])) << 16) |
+            (static_cast<std::uint64_t>(static_cast<unsigned char>(p[n / 2])) << 8) |
+            static_cast<unsigned char>(p[n - 1]);
+    }
+    return mix(kSecret1 ^ line.size(), mix(a ^ kSecret1, b ^ seed));
+}
+
+LineSet::Shard& LineSet::shardOf(std::uint64_t hash)
+{
+    return m_shards[hash >> (64 - std::countr_zero(kShards))];
+}
+
+std::optional<std::string_view> LineSet::insert(std::string_view line)
+{
+    std::uint64_t hash = hashLine(line);
+    hash = hash == kEmpty ? 1 : hash;
+    Shard& shard = shardOf(hash);
+
+    std::scoped_lock lock(shard.mutex);
+    // Every line ever added has a slot, in the arena's order.
+    if (4 * (shard.lines.size() + 1) > 3 * shard.hashes.size())
+    {
+        shard.grow();
+    }
+    const std::size_t mask = shard.hashes.size() - 1;
+    for (std::size_t slot = slotOf(hash, shard.hashes.size());; slot = (slot + 1) & mask)
+    {
+        if (shard.hashes[slot] == kEmpty)
+        {
+            shard.hashes[slot] = hash;
+            shard.indices[slot] = static_cast<std::uint32_t>(shard.lines.append(line));
+            ++shard.count;
+            return shard.lines[shard.indices[slot]];
+        }
+        const std::uint32_t index = shard.indices[slot] & ~kAbsent;
+        if (shard.hashes[slot] == hash && shard.lines[index] == line)
+        {
+            if ((shard.indices[slot] & kAbsent) == 0)
+            {
+                return std::nullopt;
+            }
+            shard.indices[slot] = index;
+            ++shard.count;
+            return shard.lines[index];
+        }
+    }
+}
+
+bool LineSet::erase(std::string_view line)
+{
+    std::uint64_t hash = hashLine(line);
+    hash = hash == kEmpty ? 1 : hash;
+    Shard& shard = shardOf(hash);
+
+    std::scoped_lock lock(shard.mutex);
+    if (shard.count == 0)
+    {
+        return false;
+    }
+    const std::size_t mask = shard.hashes.size() - 1;
+    for (std::size_t slot = slotOf(hash, shard.hashes.size()); shard.hashes[slot] != kEmpty;
+         slot = (slot + 1) & mask)
+    {
+        if (shard.hashes[slot] == hash && shard.lines[shard.indices[slot] & ~kAbsent] == line)
+        {
+            if ((shard.indices[slot] & kAbsent) != 0)
+            {
+                return false;
+            }
+            shard.indices[slot] |= kAbsent;
+            --shard.count;
+            return true;
+        }
+    }
+    return false;
+}
+
+void LineSet::Shard::grow()
+{
+    const std::size_t capacity = hashes.empty() ? 1024 : 2 * hashes.size();
+    std::vector<std::uint64_t> oldHashes(capacity, kEmpty);
+    std::vector<std::uint32_t> oldIndices(capacity);
+    oldHashes.swap(hashes);
+    oldIndices.swap(indices);
+    for (std::size_t i = 0; i < oldHashes.size(); ++i)
+    {
+        if (oldHashes[i] == kEmpty)
+        {
+            continue;
+        }
+        std::size_t slot = slotOf(oldHashes[i], capacity);
+        while (hashes[slot] != kEmpty)
+        {
+            slot = (slot + 1) & (capacity - 1);
+        }
+        hashes[slot] = oldHashes[i];
+        indices[slot] = oldIndices[i];
+    }
+}
+
+std::size_t LineSet::size() const
+{
+    std::size_t size = 0;
+    for (const Shard& shard : m_shards)
+    {
+        std::scoped_lock lock(shard.mutex);
+        size += shard.count;
+    }
+    return size;
+}
+
+std::size_t LineSet::bytes() const
+{
+    std::size_t bytes = sizeof(*this);
+    for (const Shard& shard : m_shards)
+    {
+        std::scoped_lock lock(shard.mutex);
+        bytes += shard.hashes.capacity() * sizeof(std::uint64_t) +
+                 shard.indices.capacity() * sizeof(std::uint32_t) + shard.lines.bytes();
+    }
+    return bytes;
+}
+
+}  // namespace fzf
@@ -0,0 +1,89 @@
+/// @file LineSet.h
+/// @brief Concurrent set of the distinct lines read, used to drop duplicates.
+
+#ifndef LINESET_H
+#define LINESET_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+#include "LineArena.h"
+
+namespace fzf
+{
+
+/// @brief 64-bit hash of a line, with strong enough mixing that every bit is usable (multiply
+/// and fold, as in wyhash).
+std::uint64_t hashLine(std::string_view line);
+
+/// @class LineSet
+/// @brief The distinct lines seen so far, for dropping duplicate input lines.
+///
+/// The set is split into kShards shards by the top bits of the line's hash, each with its own
+/// lock, so producers on different threads rarely wait for each other.  A shard is a flat
+/// open-addressing table (linear probing) of 12-byte slots: the full 64-bit hash and the index of
+/// the line in the shard's LineArena.  A hash match is confirmed by comparing the lines, so lines
+/// with colliding hashes are never mistaken for duplicates.
+///
+/// The set is also where the text of the input is kept: insert() returns the set's own copy of the
+/// line, which stays valid for the life of the set (see LineArena), so a Reader hands those views
+/// downstream and the Ranking borrows them rather than copying every line a second time.
+///
+/// Tables grow by doubling at a load of 3/4, so each line costs 16 to 32 bytes of table and 12
+/// bytes of arena (its start and length), 28 to 44 bytes in all, plus its characters, stored
+/// once.  Erasing a line only marks its slot absent, keeping the slot and the characters: adding
+/// the line again reuses both and returns the same view, so lines that come and go (e.g. files
+/// being rewritten) do not make the set grow.
+class LineSet
+{
+   public:
+    /// @brief Add a line.
+    /// @return The set's copy of the line, valid for the life of the set (the same view each time
+    /// an erased line is added again), if it was not in the set yet; nothing if it was.
+    std::optional<std::string_view> insert(std::string_view line);
+
+    /// @brief Remove a line.
+    /// @return true if it was in the set.
+    bool erase(std::string_view line);
+
+    /// @brief Number of distinct lines.
+    std::size_t size() const;
+
+    /// @brief Memory used by the set, in bytes.
+    std::size_t bytes() const;
+
+   private:
+    /// Number of shards; a power of two.
+    static constexpr std::size_t kShards = 64;
+    /// Hash value of empty slots; real hashes of this value are replaced by 1.
+    static constexpr std::uint64_t kEmpty = 0;
+    /// Bit of Shard::indices marking the slots of erased lines.
+    static constexpr std::uint32_t kAbsent = 1u << 31;
+
+    /// @brief One independently locked part of the set.
+    struct alignas(64) Shard
+    {
+        mutable std::mutex mutex;            ///< Guards the members below.
+        std::vector<std::uint64_t> hashes;   ///< Hash of each slot's line, or kEmpty.
+        std::vector<std::uint32_t> indices;  ///< Index of each slot's line in lines, | kAbsent.
+        LineArena lines;                     ///< The lines of this shard, erased ones included.
+        std::size_t count{0};                ///< Number of lines in the set.
+
+        /// @brief Double the table and reinsert the lines.
+        void grow();
+    };
+
+    /// @brief The shard holding the lines with the given hash.
+    Shard& shardOf(std::uint64_t hash);
+
+    std::array<Shard, kShards> m_shards;  ///< Shard i holds the hashes whose top bits are i.
+};
+
+}  // namespace fzf
+
+#endif  // LINESET_H
@@ -0,0 +1,62 @@
+/// @file QueryCache.cpp
+/// @brief Implementation of the QueryCache class.
+
+#include "QueryCache.h"
+
+namespace fzf
+{
+
+void QueryCache::put(const std::string& query, Ranking::Snapshot snapshot)
+{
+    if (auto it = m_index.find(query); it != m_index.end())
+    {
+        m_bytes -= bytes(*it->second);
+        m_entries.erase(it->second);
+        m_index.erase(it);
+    }
+
+    m_entries.emplace_front(query, std::move(snapshot));
+    const std::size_t size = bytes(m_entries.front());
+    if (size > m_budget)
+    {
+        m_entries.pop_front();  // Would evict everything else and still not fit
+        return;
+    }
+    m_index.emplace(query, m_entries.begin());
+    m_bytes += size;
+
+    while (m_bytes > m_budget)
+    {
+        m_bytes -= bytes(m_entries.back());
+        m_index.erase(m_entries.back().first);
+        m_entries.pop_back();
+    }
+}
+
+bool QueryCache::wants(const std::string& query, std::size_t size, std::size_t bytes)
+{
+    if (query.capacity() + bytes > m_budget)
+    {
+        return false;
+    }
+    auto it = m_index.find(query);
+    if (it == m_index.end() || it->second->second.size != size)
+    {
+        return true;
+    }
+    m_entries.splice(m_entries.begin(), m_entries, it->second);
+    return false;
+}
+
+const Ranking::Snapshot* QueryCache::get(const std::string& query)
+{
+    auto it = m_index.find(query);
+    if (it == m_index.end())
+    {
+        return nullptr;
+    }
+    m_entries.splice(m_entries.begin(), m_entries, it->second);
+    return &it->second->second;
+}
+
+}  // namespace fzf
@@ -0,0 +1,71 @@
+/// @file QueryCache.h
+/// @brief Least-recently-used cache of rankings, keyed by query.
+
+#ifndef QUERYCACHE_H
+#define QUERYCACHE_H
+
+#include <cstddef>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include "Ranking.h"
+
+namespace fzf
+{
+
+/// @class QueryCache
+/// @brief Rankings of recent queries, so that going back to a query (e.g. with Backspace) costs a
+/// lookup instead of a rescore.
+///
+/// Entries are Ranking::Snapshot objects.  Candidate Ids never change, so an entry stays valid as
+/// lines are added; Ranking::restore() scores the lines that arrived after it was taken.  The
+/// least recently used entries are evicted once the snapshots exceed the memory budget.
+class QueryCache
+{
+   public:
+    /// @brief Construct a cache.
+    /// @param budget Memory budget in bytes; 0 disables the cache.
+    explicit QueryCache(std::size_t budget) : m_budget(budget) {}
+
+    /// @brief Store the ranking for query, replacing any previous entry.
+    void put(const std::string& query, Ranking::Snapshot snapshot);
+
+    /// @brief Whether put() would store a new ranking for query, so that the caller can skip
+    /// taking a snapshot that would be dropped.
+    ///
+    /// False if query is cached with a snapshot of the same Ranking::size() (which is then marked
+    /// as most recently used, as put() would), or if a snapshot of `bytes` cannot fit the budget.
+    /// @param size Ranking::size() of the ranking.
+    /// @param bytes Ranking::Snapshot::bytesFor() its accepted candidates.
+    bool wants(const std::string& query, std::size_t size, std::size_t bytes);
+
+    /// @brief Ranking stored for query, marking it as most recently used.
+    /// @return The snapshot, or nullptr if query is not cached.  Valid until the next put().
+    const Ranking::Snapshot* get(const std::string& query);
+
+    /// @brief Number of cached queries.
+    std::size_t size() const { return m_entries.size(); }
+
+    /// @brief Memory used by the cached snapshots, in bytes.
+    std::size_t bytes() const { return m_bytes; }
+
+   private:
+    using Entry = std::pair<std::string, Ranking::Snapshot>;
+
+    /// @brief Memory accounted to an entry.
+    static std::size_t bytes(const Entry& entry)
+    {
+        return entry.first.capacity() + entry.second.bytes();
+    }
+
+    std::size_t m_budget;        ///< Memory budget in bytes.
+    std::size_t m_bytes{0};      ///< Memory used by m_entries.
+    std::list<Entry> m_entries;  ///< Entries, most recently used first.
+    std::unordered_map<std::string, std::list<Entry>::iterator> m_index;  ///< Entries by query.
+};
+
+}  // namespace fzf
+
+#endif  // QUERYCACHE_H
@@ -0,0 +1,522 @@
+/// @file Ranking.cpp
+/// @brief Implementation of the Ranking class.
+
+#include "Ranking.h"
+
+#include <algorithm>
+#include <iterator>
+
+#include "LineSet.h"
+
+namespace fzf
+{
+
+bool rankedBefore(const Candidate& a, const Candidate& b)
+{
+    if (a.score == b.score)
+    {
+        return b.line.size() > a.line.size();  // Shorter lines first if scores are equal
+    }
+    return b.score < a.score;  // Higher scores first
+}
+
+namespace
+{
+/// The m_index slot of a line's hash in a table of `capacity` slots.
+std::size_t slotOf(std::uint32_t hash, std::size_t capacity) { return hash & (capacity - 1); }
+
+/// The part of a line's hash kept by the index.
+std::uint32_t indexHash(std::string_view line)
+{
+    return static_cast<std::uint32_t>(hashLine(line) >> 32);
+}
+}  // namespace
+
+Ranking::Entry Ranking::store(const Candidate& candidate)
+{
+    return Entry{storeLine(candidate.line, candidate.mask), candidate.score,
+                 static_cast<std::uint32_t>(candidate.line.size())};
+}
+
+void Ranking::append(std::string_view line, CharMask mask) { storeLine(line, mask); }
+
+Ranking::Id Ranking::storeLine(std::string_view line, CharMask mask)
+{
+    const Id id = static_cast<Id>(m_lines.size());
+    if (!m_index.empty())
+    {
+        // Once lines have been removed, every line is indexed, and one added again is revived.
+        if (4 * (m_indexed + 1) > 3 * m_index.size())
+        {
+            growIndex();
+        }
+        const std::uint32_t hash = indexHash(line);
+        const std::size_t last = m_index.size() - 1;
+        std::size_t slot = slotOf(hash, m_index.size());
+        for (; m_index[slot].id != kNoId; slot = (slot + 1) & last)
+        {
+            const Id other = m_index[slot].id;
+            if (m_removed[other] && m_index[slot].hash == hash && m_lines[other] == line)
+            {
+                m_removed[other] = false;
+                m_masks[other] = mask;
+                // The log is bounded by clearing it; restore() then checks every candidate.
+                if (m_revivals.size() >= m_lines.size())
+                {
+                    m_revivals.clear();
+                    ++m_revivalEpoch;
+                }
+                m_revivals.push_back(other);
+                return other;
+            }
+        }
+        m_index[slot] = IndexSlot{hash, id};
+        ++m_indexed;
+    }
+    if (m_storage == LineStorage::Borrowed)
+    {
+        m_lines.adopt(line);
+    }
+    else
+    {
+        m_lines.append(line);
+    }
+    m_masks.push_back(mask);
+    m_positions.push_back(kNotRanked);
+    m_removed.push_back(false);
+    return id;
+}
+
+void Ranking::buildIndex()
+{
+    growIndex();
+    while (4 * m_lines.size() > 3 * m_index.size())
+    {
+        growIndex();
+    }
+    const std::size_t mask = m_index.size() - 1;
+    for (std::size_t id = 0; id < m_lines.size(); ++id)
+    {
+        const std::uint32_t hash = indexHash(m_lines[id]);
+        std::size_t slot = slotOf(hash, m_index.size());
+        while (m_index[slot].id != kNoId)
+        {
+            slot = (slot + 1) & mask;
+        }
+        m_index[slot] = IndexSlot{hash, static_cast<Id>(id)};
+    }
+    m_indexed = m_lines.size();
+}
+
+void Ranking::growIndex()
+{
+    const std::size_t capacity = m_index.empty() ? 1024 : 2 * m_index.size();
+    std::vector<IndexSlot> old(capacity, IndexSlot{0, kNoId});
+    old.swap(m_index);
+    for (const IndexSlot& entry : old)
+    {
+        if (entry.id == kNoId)
+        {
+            continue;
+        }
+        std::size_t slot = slotOf(entry.hash, capacity);
+        while (m_index[slot].id != kNoId)
+        {
+            slot = (slot + 1) & (capacity - 1);
+        }
+        m_index[slot] = entry;
+    }
+}
+
+Ranking::Entry Ranking::scored(Id id, const CompiledQuery& query) const
+{
+    const std::string_view line = m_lines[id];
+    return Entry{id, query.score(line, m_masks[id]), static_cast<std::uint32_t>(line.size())};
+}
+
+bool Ranking::rescore(const CompiledQuery& query, std::size_t visible, const Cancelled& cancelled)
+{
+    m_accepted.resize(m_lines.size());
+    std::transform(m_removed.begin(), m_removed.end(), m_accepted.begin(),
+                   [](char removed) { return !removed; });
+    return scoreAccepted(query, visible, cancelled);
+}
+
+bool Ranking::refine(const CompiledQuery& query, std::size_t visible, const Cancelled& cancelled)
+{
+    // Lines rejected by the previous query are rejected by this one too.
+    m_accepted.assign(m_lines.size(), false);
+    for (const Entry& entry : m_order)
+    {
+        m_accepted[entry.id] = true;
+    }
+    return scoreAccepted(query, visible, cancelled);
+}
+
+bool Ranking::scoreAccepted(const CompiledQuery& query, std::size_t visible,
+                            const Cancelled& cancelled)
+{
+    const std::size_t chunks = (m_lines.size() + kChunkSize - 1) / kChunkSize;
+    m_chunks.resize(chunks);
+    // Once cancelled, the remaining chunks are skipped; only m_chunks has been written to, so the
+    // ranking still holds the previous pass.
+    auto isCancelled = [&]() { return cancelled && cancelled(); };
+    auto body = [&](std::size_t index)
+    {
+        if (!isCancelled())
+        {
+            scoreChunk(index, query, visible);
+        }
+    };
+    if (m_pool != nullptr)
+    {
+        m_pool->parallelFor(chunks, body);
+    }
+    else
+    {
+        for (std::size_t index = 0; index < chunks; ++index)
+        {
+            body(index);
+        }
+    }
+    if (isCancelled())
+    {
+        return false;
+    }
+
+    // Merge the chunks' best matches.  They are gathered in chunk order and sorted stably, so
+    // ties are taken from earlier chunks first and every chunk contributes a prefix of its own.
+    std::vector<Entry> best;
+    std::size_t matchCount = 0;
+    for (auto& chunk : m_chunks)
+    {
+        best.insert(best.end(), chunk.entries.begin(), chunk.entries.begin() + chunk.orderedCount);
+        matchCount += chunk.matchCount;
+        chunk.taken = 0;
+    }
+    std::stable_sort(best.begin(), best.end(), before);
+    best.resize(std::min(best.size(), visible));
+    for (const Entry& entry : best)
+    {
+        ++m_chunks[entry.id / kChunkSize].taken;
+    }
+
+    unindex();
+    m_order.assign(best.begin(), best.end());
+    for (const auto& chunk : m_chunks)
+    {
+        m_order.insert(m_order.end(), chunk.entries.begin() + chunk.taken,
+                       chunk.entries.begin() + chunk.matchCount);
+    }
+    for (const auto& chunk : m_chunks)
+    {
+        m_order.insert(m_order.end(), chunk.entries.begin() + chunk.matchCount,
+                       chunk.entries.end());
+    }
+    reindex(0, m_order.size());
+    m_matchCount = matchCount;
+    m_orderedCount = best.size();
+    return true;
+}
+
+void Ranking::scoreChunk(std::size_t index, const CompiledQuery& query, std::size_t visible)
+{
+    Chunk& chunk = m_chunks[index];
+    chunk.entries.clear();
+    const std::size_t end = std::min(m_lines.size(), (index + 1) * kChunkSize);
+    for (std::size_t id = index * kChunkSize; id < end; ++id)
+    {
+        if (!m_accepted[id])
+        {
+            continue;
+        }
+        Entry entry = scored(static_cast<Id>(id), query);
+        if (entry.score != CompiledQuery::kNoMatch)
+        {
+            chunk.entries.push_back(entry);
+        }
+    }
+    auto firstNonMatch = std::partition(chunk.entries.begin(), chunk.entries.end(),
+                                        [](const Entry& e) { return e.score > 0; });
+    chunk.matchCount = std::distance(chunk.entries.begin(), firstNonMatch);
+    chunk.orderedCount = std::min(chunk.matchCount, visible);
+    std::partial_sort(chunk.entries.begin(), chunk.entries.begin() + chunk.orderedCount,
+                      firstNonMatch, before);
+}
+
+std::size_t Ranking::place(const Entry& entry)
+{
+    // Appended to the non-match region; a match then swaps places with the first non-match,
+    // which moves to the end of its region.
+    m_order.push_back(entry);
+    if (entry.score <= 0)
+    {
+        reindex(m_order.size() - 1, m_order.size());
+        return m_order.size() - 1;
+    }
+    std::swap(m_order[m_matchCount], m_order.back());
+    reindex(m_order.size() - 1, m_order.size());
+    reindex(m_matchCount, m_matchCount + 1);
+    return m_matchCount++;
+}
+
+void Ranking::insert(const Entry& entry)
+{
+    if (entry.score == CompiledQuery::kNoMatch)
+    {
+        return;
+    }
+    std::size_t position = place(entry);
+    if (position >= m_matchCount)
+    {
+        return;
+    }
+
+    // If it outranks the last ordered entry, it takes that entry's place in the ordered prefix
+    // (the displaced entry still ranks before all unordered ones) and is then rotated into
+    // position.  This costs O(orderedCount()) rather than O(size()).
+    if (m_orderedCount > 0 && before(entry, m_order[m_orderedCount - 1]))
+    {
+        auto last = m_order.begin() + m_orderedCount - 1;
+        std::iter_swap(m_order.begin() + position, last);
+        auto it = std::upper_bound(m_order.begin(), last, *last, before);
+        std::rotate(it, last, last + 1);
+        reindex(position, position + 1);
+        reindex(std::distance(m_order.begin(), it), m_orderedCount);
+    }
+}
+
+void Ranking::add(const Candidate& candidate) { insert(store(candidate)); }
+
+void Ranking::merge(const std::vector<Candidate>& batch)
+{
+    std::vector<Entry> entries;
+    for (const auto& candidate : batch)
+    {
+        Entry entry = store(candidate);
+        if (entry.score != CompiledQuery::kNoMatch)
+        {
+            entries.push_back(entry);
+        }
+    }
+    auto batchEnd = std::partition(entries.begin(), entries.end(),
+                                   [](const Entry& e) { return e.score > 0; });
+    std::sort(entries.begin(), batchEnd, before);
+
+    // Append the batch's matches to the match region, where they stay contiguous and in order,
+    // then the rest of the batch.
+    const std::size_t first = m_matchCount;
+    const std::size_t count = std::distance(entries.begin(), batchEnd);
+    for (const Entry& entry : entries)
+    {
+        place(entry);
+    }
+
+    if (m_orderedCount == 0 || count == 0)
+    {
+        return;
+    }
+
+    // The batch matches that outrank the last ordered entry are merged into the ordered prefix.
+    // The prefix keeps its length; what falls off its end takes the batch's slots, where it
+    // still ranks before every unordered match.
+    const Entry tail = m_order[m_orderedCount - 1];
+    auto newBegin = m_order.begin() + first;
+    auto newEnd = std::partition_point(newBegin, newBegin + count,
+                                       [&](const Entry& e) { return before(e, tail); });
+    if (newBegin == newEnd)
+    {
+        return;
+    }
+    std::vector<Entry> merged;
+    merged.reserve(m_orderedCount + std::distance(newBegin, newEnd));
+    std::merge(m_order.begin(), m_order.begin() + m_orderedCount, newBegin, newEnd,
+               std::back_inserter(merged), before);
+    auto split = merged.begin() + m_orderedCount;
+    std::copy(merged.begin(), split, m_order.begin());
+    std::copy(split, merged.end(), newBegin);
+    reindex(0, m_orderedCount);
+    reindex(first, first + merged.size() - m_orderedCount);
+}
+
+void Ranking::ensureOrdered(std::size_t count)
+{
+    count = std::min(count, m_matchCount);
+    if (count <= m_orderedCount)
+    {
+        return;
+    }
+    std::partial_sort(m_order.begin() + m_orderedCount, m_order.begin() + count,
+                      m_order.begin() + m_matchCount, before);
+    reindex(m_orderedCount, m_matchCount);
+    m_orderedCount = count;
+}
+
+Ranking::Snapshot Ranking::snapshot() const
+{
+    return Snapshot{m_order,         m_matchCount,       m_orderedCount,
+                    m_lines.size(), m_revivals.size(), m_revivalEpoch};
+}
+
+void Ranking::restore(const Snapshot& snapshot, const CompiledQuery& query, std::size_t visible)
+{
+    unindex();
+    m_order = snapshot.accepted;
+    m_matchCount = snapshot.matchCount;
+    m_orderedCount = snapshot.orderedCount;
+    prune();  // Candidates removed since the snapshot was taken
+
+    // Lines that arrived after the snapshot was taken.
+    for (std::size_t id = snapshot.size; id < m_lines.size(); ++id)
+    {
+        if (!m_removed[id])
+        {
+            insert(scored(static_cast<Id>(id), query));
+        }
+    }
+    // Lines removed and added again since, which the snapshot may not rank.  Those it does rank
+    // have kept their score, their line being the same.
+    auto revived = [&](Id id)
+    {
+        if (id < snapshot.size && !m_removed[id] && m_positions[id] == kNotRanked)
+        {
+            insert(scored(id, query));
+        }
+    };
+    if (snapshot.revivalEpoch == m_revivalEpoch)
+    {
+        for (std::size_t i = snapshot.revivals; i < m_revivals.size(); ++i)
+        {
+            revived(m_revivals[i]);
+        }
+    }
+    else
+    {
+        for (std::size_t id = 0; id < snapshot.size; ++id)
+        {
+            revived(static_cast<Id>(id));
+        }
+    }
+    ensureOrdered(visible);
+}
+
+std::size_t Ranking::remove(std::span<const std::string_view> lines)
+{
+    if (m_index.empty())
+    {
+        buildIndex();
+    }
+    std::vector<Id> removed;
+    const std::size_t mask = m_index.size() - 1;
+    for (std::string_view line : lines)
+    {
+        const std::uint32_t hash = indexHash(line);
+        for (std::size_t slot = slotOf(hash, m_index.size()); m_index[slot].id != kNoId;
+             slot = (slot + 1) & mask)
+        {
+            const Id id = m_index[slot].id;
+            if (!m_removed[id] && m_index[slot].hash == hash && m_lines[id] == line)
+            {
+                m_removed[id] = true;
+                removed.push_back(id);
+            }
+        }
+    }
+    if (removed.size() * kPruneRatio > m_order.size())
+    {
+        unindex();
+        prune();
+    }
+    else
+    {
+        for (Id id : removed)
+        {
+            if (m_positions[id] != kNotRanked)
+            {
+                erase(m_positions[id]);
+            }
+        }
+    }
+    return removed.size();
+}
+
+void Ranking::erase(std::size_t position)
+{
+    const Id id = m_order[position].id;
+    // The entry moves to the end of each region in turn, as place() in reverse: the ordered
+    // prefix closes up over it and gives up its last slot, then it swaps places with the last
+    // match, which the unordered matches may do, and with the last entry.
+    if (position < m_orderedCount)
+    {
+        std::rotate(m_order.begin() + position, m_order.begin() + position + 1,
+                    m_order.begin() + m_orderedCount);
+        --m_orderedCount;
+        reindex(position, m_orderedCount);
+        position = m_orderedCount;
+    }
+    if (position < m_matchCount)
+    {
+        std::swap(m_order[position], m_order[m_matchCount - 1]);
+        reindex(position, position + 1);
+        position = --m_matchCount;
+    }
+    std::swap(m_order[position], m_order.back());
+    reindex(position, position + 1);
+    m_order.pop_back();
+    m_positions[id] = kNotRanked;
+}
+
+void Ranking::prune()
+{
+    // The ordered prefix stays in order and still ranks before every unordered match.
+    std::size_t removedOrdered = 0;
+    std::size_t removedMatches = 0;
+    for (std::size_t position = 0; position < m_matchCount; ++position)
+    {
+        if (m_removed[m_order[position].id])
+        {
+            removedOrdered += position < m_orderedCount;
+            ++removedMatches;
+        }
+    }
+    std::erase_if(m_order, [this](const Entry& entry) { return m_removed[entry.id] != 0; });
+    m_orderedCount -= removedOrdered;
+    m_matchCount -= removedMatches;
+    reindex(0, m_order.size());
+}
+
+void Ranking::reindex(std::size_t begin, std::size_t end)
+{
+    for (std::size_t position = begin; position < end; ++position)
+    {
+        m_positions[m_order[position].id] = static_cast<std::uint32_t>(position);
+    }
+}
+
+void Ranking::unindex()
+{
+    for (const Entry& entry : m_order)
+    {
+        m_positions[entry.id] = kNotRanked;
+    }
+}
+
+std::size_t Ranking::find(Id id)
+{
+    std::size_t position = this->position(id);
+    if (position < m_orderedCount || position >= m_matchCount)
+    {
+        return position;
+    }
+
+    // An unordered match: ordering every unordered match that does not rank after it (itself and
+    // any ties included) brings it into the ordered prefix.
+    const Entry entry = m_order[position];
+    std::size_t count =
+        std::count_if(m_order.begin() + m_orderedCount, m_order.begin() + m_matchCount,
+                      [&](const Entry& other) { return !before(entry, other); });
+    ensureOrdered(m_orderedCount + count);
+    return m_positions[id];
+}
+
+}  // namespace fzf
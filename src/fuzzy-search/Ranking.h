@@ -0,0 +1,296 @@
+/// @file Ranking.h
+/// @brief Scored candidate lines, ordered only as far as the display needs.
+
+#ifndef RANKING_H
+#define RANKING_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "CharMask.h"
+#include "CompiledQuery.h"
+#include "LineArena.h"
+#include "ThreadPool.h"
+
+namespace fzf
+{
+
+/// @brief A line read from the input and its score against the query it is added under.
+struct Candidate
+{
+    std::string_view line;  ///< The line; see Ranking::LineStorage for how long it must live.
+    CharMask mask;          ///< Characters present in the line.
+    int score{0};           ///< Only scores > 0 are matches, and CompiledQuery::kNoMatch marks
+                            ///< lines the query rejected.
+};
+
+/// @brief Ranking order: higher scores first, shorter lines first on equal scores.
+bool rankedBefore(const Candidate& a, const Candidate& b);
+
+/// @class Ranking
+/// @brief The candidate list, kept partially ordered.
+///
+/// Lines are stored in arrival order in a LineArena (or only referenced there, when borrowed from
+/// a Reader: see LineStorage), with their masks in a parallel array, and
+/// identified by their index (Id), which never changes.  The ranking is a list of compact entries
+/// (Id, score and line length) for the lines accepted by the current query, plus the position of
+/// each Id in that list, so that partitioning, sorting and snapshots never touch the lines
+/// themselves.  Only the part of it that is displayed (plus a margin for navigation) needs to be
+/// in rank order, so instead of sorting everything on each keystroke it is kept in three regions:
+///
+///   [0, orderedCount())                the best matches, in rank order
+///   [orderedCount(), matchCount())     the remaining matches, unordered
+///   [matchCount(), acceptedCount())    accepted by the query, but with a score <= 0
+///
+/// Candidates rejected by the query (CompiledQuery::kNoMatch) are not ranked at all.  Every
+/// ordered candidate ranks before every unordered one, and ensureOrdered() extends the ordered
+/// prefix on demand as the selection moves down the list.  Rescoring is therefore O(n) plus
+/// O(n log k) for the k candidates actually ordered.  When the query is refined (see
+/// CompiledQuery::isRefinedBy), refine() only rescores the candidates the previous query
+/// accepted, and restore() brings back a ranking saved with snapshot().
+///
+/// Scoring runs over fixed chunks of kChunkSize lines, optionally spread over a ThreadPool.  Each
+/// chunk also orders its own best matches, and the chunks' best matches are merged into the
+/// ordered prefix.  The chunks do not depend on the number of threads, so neither does the
+/// resulting ranking.
+///
+/// Candidates can be removed again (see remove()).  A removed candidate keeps its Id and line but
+/// is not ranked, until the same line is added again: it then gets its Id back, so that lines
+/// coming and going (e.g. files being rewritten) do not make the ranking grow.  Lines are found by
+/// an index of 8-byte slots (hash and Id, confirmed against the line) built on the first removal,
+/// which makes removing O(removed) rather than a pass over every candidate.
+class Ranking
+{
+   public:
+    /// @brief How the ranking keeps the lines it is given.
+    enum class LineStorage
+    {
+        Copied,   ///< Each line is copied; it only has to live through the call adding it.
+        Borrowed  ///< Lines are referenced, and must stay valid, at the same address, as long as
+                  ///< the ranking is used: e.g. the lines delivered by a Reader.
+    };
+
+    /// @brief Construct an empty ranking.
+    /// @param pool Threads to score with, or nullptr to score on the calling thread.
+    /// @param storage How lines are kept.
+    explicit Ranking(ThreadPool* pool = nullptr, LineStorage storage = LineStorage::Copied)
+        : m_pool(pool), m_storage(storage)
+    {
+    }
+
+    /// @brief Stable identifier of a candidate: its position in arrival order.
+    using Id = std::uint32_t;
+
+    /// @brief A ranked line.
+    struct Entry
+    {
+        Id id;                 ///< The line.
+        int score;             ///< Its score against the current query.
+        std::uint32_t length;  ///< Its length, which breaks ties between equal scores.
+    };
+
+    /// @brief The ranking for one query, as saved by snapshot().
+    struct Snapshot
+    {
+        std::vector<Entry> accepted;  ///< The accepted entries, in ranking order.
+        std::size_t matchCount{0};    ///< matchCount() when taken.
+        std::size_t orderedCount{0};  ///< orderedCount() when taken.
+        std::size_t size{0};          ///< size() when taken.
+        std::size_t revivals{0};      ///< Length of the log of revived Ids when taken.
+        std::size_t revivalEpoch{0};  ///< Number of times that log had been cleared.
+
+        /// @brief Approximate memory used by the snapshot.
+        std::size_t bytes() const { return bytesFor(accepted.capacity()); }
+
+        /// @brief Approximate memory used by a snapshot of `accepted` entries, for deciding
+        /// whether to take one.
+        static std::size_t bytesFor(std::size_t accepted)
+        {
+            return sizeof(Snapshot) + accepted * sizeof(Entry);
+        }
+    };
+
+    /// @brief Polled between chunks of a scoring pass; returning true abandons the pass.  Once it
+    /// has returned true it must keep doing so.
+    using Cancelled = std::function<bool()>;
+
+    /// @brief Score every candidate against query and order the first `visible` matches.
+    /// @return false if the pass was cancelled, in which case the ranking is left unchanged.
+    bool rescore(const CompiledQuery& query, std::size_t visible,
+                 const Cancelled& cancelled = {});
+
+    /// @brief Like rescore(), but only looks at the candidates accepted by the previous query.
+    /// @pre The previous query isRefinedBy(query).
+    /// @return false if the pass was cancelled, in which case the ranking is left unchanged.
+    bool refine(const CompiledQuery& query, std::size_t visible,
+                const Cancelled& cancelled = {});
+
+    /// @brief Add a candidate that has already been scored, keeping the regions intact.
+    void add(const Candidate& candidate);
+
+    /// @brief Store a line without ranking it, for the next rescore() to score.
+    ///
+    /// When the whole input is scored at once, this saves add()'s scoring of each line.
+    void append(std::string_view line, CharMask mask);
+
+    /// @brief Add a batch of already scored candidates, keeping the regions intact.
+    ///
+    /// The batch is sorted once and merged into the ordered prefix, which costs
+    /// O(b log b + orderedCount()) for a batch of b candidates regardless of size().
+    void merge(const std::vector<Candidate>& batch);
+
+    /// @brief Remove every candidate whose line is one of lines, keeping the regions intact.
+    ///
+    /// The candidates are looked up in the line index.  A few are taken out of the ranking one by
+    /// one, each in O(orderedCount()) at worst; more than 1/kPruneRatio of acceptedCount() at
+    /// once are taken out in one O(acceptedCount()) pass.
+    /// @return The number of candidates removed.
+    std::size_t remove(std::span<const std::string_view> lines);
+
+    /// @brief Whether the candidate with the given Id (< size()) was removed.
+    bool removed(Id id) const { return m_removed[id] != 0; }
+
+    /// @brief Make sure the first `count` matches (or all of them, if fewer) are in rank order.
+    void ensureOrdered(std::size_t count);
+
+    /// @brief Save the current ranking.
+    Snapshot snapshot() const;
+
+    /// @brief Bring back a ranking saved with snapshot() under the same query.
+    ///
+    /// Candidates added since the snapshot was taken, removed ones added again included, are
+    /// scored against query, so this costs O(acceptedCount()) plus the new candidates rather
+    /// than a pass over every candidate.
+    void restore(const Snapshot& snapshot, const CompiledQuery& query, std::size_t visible);
+
+    /// @brief Total number of candidates, removed ones included.
+    std::size_t size() const { return m_lines.size(); }
+
+    /// @brief Number of candidates with a positive score.
+    std::size_t matchCount() const { return m_matchCount; }
+
+    /// @brief Number of candidates accepted by the query (matches included).
+    std::size_t acceptedCount() const { return m_order.size(); }
+
+    /// @brief Number of candidates at the front of the ranking that are in rank order.
+    std::size_t orderedCount() const { return m_orderedCount; }
+
+    /// @brief Line at the given ranking position (< acceptedCount()).  The view is valid as long
+    /// as the ranking.
+    std::string_view line(std::size_t position) const { return m_lines[m_order[position].id]; }
+
+    /// @brief Score at the given ranking position (< acceptedCount()).
+    int score(std::size_t position) const { return m_order[position].score; }
+
+    /// @brief Id of the candidate at the given ranking position (< acceptedCount()).
+    Id id(std::size_t position) const { return m_order[position].id; }
+
+    /// @brief Line of the candidate with the given Id (< size()).  The view is valid as long as
+    /// the ranking.
+    std::string_view lineById(Id id) const { return m_lines[id]; }
+
+    /// @brief Current ranking position of the candidate with the given Id (< size()).
+    /// @return The position, or acceptedCount() if the query rejected it.
+    std::size_t position(Id id) const
+    {
+        return m_positions[id] == kNotRanked ? m_order.size() : m_positions[id];
+    }
+
+    /// @brief Ranking position of the candidate with the given Id (< size()), ordering the
+    /// ranking up to it if necessary.
+    ///
+    /// This is O(1) unless the candidate is an unordered match, which costs a pass over the
+    /// unordered matches.
+    /// @return The position, or acceptedCount() if the query rejected it.
+    std::size_t find(Id id);
+
+   private:
+    /// Lines per scoring chunk; the chunk's entries stay in cache while it is ordered.
+    static constexpr std::size_t kChunkSize = 4096;
+    /// m_positions value of the lines the query rejected.
+    static constexpr std::uint32_t kNotRanked = UINT32_MAX;
+    /// remove() compacts the whole ranking when more than 1/kPruneRatio of it goes.
+    static constexpr std::size_t kPruneRatio = 16;
+    /// Id of the empty slots of m_index.
+    static constexpr Id kNoId = UINT32_MAX;
+
+    /// @brief A slot of the line index.
+    struct IndexSlot
+    {
+        std::uint32_t hash;  ///< Top bits of the line's hashLine().
+        Id id;               ///< The line, or kNoId.
+    };
+
+    /// @brief Result of scoring one chunk of lines.
+    struct Chunk
+    {
+        std::vector<Entry> entries;  ///< Accepted entries: [ordered | matches | non-matches].
+        std::size_t matchCount{0};   ///< Number of matches among entries.
+        std::size_t orderedCount{0};  ///< Number of best matches in rank order at the front.
+        std::size_t taken{0};         ///< Number of ordered entries merged into the prefix.
+    };
+
+    /// @brief Ranking order of two entries, as rankedBefore().
+    static bool before(const Entry& a, const Entry& b)
+    {
+        return a.score == b.score ? a.length < b.length : a.score > b.score;
+    }
+    /// @brief Store a candidate's line.
+    /// @return Its ranking entry.
+    Entry store(const Candidate& candidate);
+    /// @brief Store a line, giving a removed candidate with the same line its Id back if there
+    /// is one.
+    /// @return Its Id.
+    Id storeLine(std::string_view line, CharMask mask);
+    /// @brief Index the lines of every candidate.
+    void buildIndex();
+    /// @brief Double the line index, or create it.
+    void growIndex();
+    /// @brief Take the entry at the given position out of the ranking, keeping the regions.
+    void erase(std::size_t position);
+    /// @brief Score a stored line against query.
+    /// @return Its ranking entry.
+    Entry scored(Id id, const CompiledQuery& query) const;
+    /// @brief Score the lines flagged in m_accepted and rank those the query accepts.
+    /// @return false if cancelled before the ranking was rebuilt.
+    bool scoreAccepted(const CompiledQuery& query, std::size_t visible,
+                       const Cancelled& cancelled);
+    /// @brief Score the flagged lines of chunk `index` and order its `visible` best matches.
+    void scoreChunk(std::size_t index, const CompiledQuery& query, std::size_t visible);
+    /// @brief Append an accepted entry at the end of its region.
+    /// @return The position it was placed at.
+    std::size_t place(const Entry& entry);
+    /// @brief Place a scored entry and fix up the ordered prefix.
+    void insert(const Entry& entry);
+    /// @brief Record the positions of the entries in m_order[begin, end).
+    void reindex(std::size_t begin, std::size_t end);
+    /// @brief Mark every entry of m_order as not ranked, before m_order is replaced.
+    void unindex();
+    /// @brief Drop the removed candidates from m_order, keeping the regions and their order.
+    void prune();
+
+    ThreadPool* m_pool;             ///< Threads to score with, if any.
+    LineStorage m_storage;          ///< Whether m_lines copies lines or adopts them.
+    LineArena m_lines;              ///< All lines, indexed by Id.
+    std::vector<CharMask> m_masks;  ///< Characters present in each line, indexed by Id.
+    std::vector<Entry> m_order;     ///< Accepted entries, in the regions described above.
+    std::vector<std::uint32_t> m_positions;  ///< Position of each line in m_order, by Id.
+    std::vector<char> m_removed;    ///< Whether each line was removed, by Id.
+    std::vector<IndexSlot> m_index;  ///< Open-addressing table of the lines; empty until needed.
+    std::size_t m_indexed{0};       ///< Number of lines in m_index.
+    std::vector<Id> m_revivals;     ///< Removed candidates added again, for restore().
+    std::size_t m_revivalEpoch{0};  ///< Number of times m_revivals was cleared.
+    std::vector<char> m_accepted;   ///< Lines to score in scoreAccepted(), by Id.
+    std::vector<Chunk> m_chunks;    ///< Scratch space for scoreAccepted().
+    std::size_t m_matchCount{0};    ///< Number of candidates with a positive score.
+    std::size_t m_orderedCount{0};  ///< Length of the ordered prefix.
+};
+
+}  // namespace fzf
+
+#endif  // RANKING_H
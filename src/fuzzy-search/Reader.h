@@ -1,10 +1,17 @@
 #pragma once
+#include <atomic>
 #include <mutex>
+#include <optional>
+#include <span>
 #include <string>
-#include <unordered_set>
+#include <string_view>
 #include <vector>
 #include <functional>
 
+#include "CharMask.h"
+#include "LineArena.h"
+#include "LineSet.h"
+
 namespace fzf
 {
 
@@ -14,6 +21,18 @@ namespace fzf
 /// Provides thread-safe storage of unique lines, notifies listeners via Boost.Signals2 when new
 /// lines are added, and tracks reading status. Intended for use in fuzzy search applications where
 /// input may come from files, streams, or other sources.
+///
+/// Listeners are notified once per batch of lines rather than once per line, so that locking,
+/// scoring setup and redrawing are paid per batch.  Readers pass their lines to addLines() in
+/// batches of up to kBatchSize; addLine() delivers a single line at once, so it is only meant for
+/// readers producing few lines.
+///
+/// The Reader keeps the one copy of the text of the input: the lines it delivers are views into
+/// its LineSet (or, without deduplication, into a plain LineArena), valid for the life of the
+/// Reader, so listeners keep the views instead of copying the lines.
+///
+/// Readers whose input can change after it has been read (see FileListReader's watch mode) take
+/// lines back with removeLines(), which notifies onRemove.
 class Reader
 {
    public:
@@ -23,13 +42,15 @@ class Reader
     /// @brief Virtual destructor.
     virtual ~Reader() = default;
 
-    /// @brief Returns a copy of all unique lines read so far.
-    /// @return std::vector<std::string> The lines read.
-    std::unordered_set<std::size_t> getSeenValues() const
-    {
-        std::scoped_lock lock(m_mutex);
-        return m_seenLines;
-    }
+    /// @brief Returns the number of lines delivered so far, less those removed since.  Without
+    /// deduplication every copy of a line counts, and removals are not subtracted (one removal
+    /// takes back every copy).
+    std::size_t seenCount() const { return m_seenCount; }
+
+    /// @brief Whether duplicate lines are dropped (the default).  Turning this off saves the
+    /// time and the 16 to 32 bytes per line of table of the LineSet for inputs known to be
+    /// unique.  Set before start().
+    void setDeduplicate(bool deduplicate) { m_deduplicate = deduplicate; }
 
     /// @brief Starts the reading process. Must be implemented by derived classes.
     virtual void start() = 0;
@@ -42,6 +63,7 @@ class Reader
     {
         std::scoped_lock lock(m_mutex);
         onUpdate = {};
+        onRemove = {};
     }
 
     /// @enum ReadStatus
@@ -56,40 +78,132 @@ class Reader
     /// @return ReadStatus The current status.
     ReadStatus status() const { return m_status; }
 
-    /// @brief Adds a line if it is non-empty and not already seen. Notifies listeners if added.
-    /// @param line The line to add.
-    /// @return true if the line was added, false otherwise.
-    bool addLine(std::string line)
+    /// @brief A line delivered to listeners.
+    struct Line
     {
-        auto hashValue =  m_hash(line);
-        if (line.empty() || m_seenLines.contains(hashValue))
+        std::string_view text;  ///< The Reader's copy of the line, valid for the Reader's life.
+        CharMask mask;          ///< The characters present in text.
+    };
+
+    /// @brief Lines delivered by one notification.
+    using Batch = std::span<const Line>;
+
+    /// Number of lines readers pass to addLines() at a time.
+    static constexpr std::size_t kBatchSize = 4096;
+
+    /// @brief Adds the lines that are non-empty and not already seen, and notifies listeners once
+    /// with those added.
+    ///
+    /// Each line's character mask is computed here, once, so that scoring can reject lines that
+    /// lack a query character without looking at the line again.  The lines are only borrowed
+    /// for the duration of the call: those added are copied into the Reader, once, and delivered
+    /// as views of that copy.  Safe to call from several threads: duplicates are dropped by the
+    /// concurrent LineSet, and only the notification is serialized.
+    /// @param lines The lines to add.
+    /// @return The number of lines added.
+    std::size_t addLines(std::span<const std::string_view> lines)
+    {
+        std::vector<Line> batch;
+        batch.reserve(lines.size());
+        if (m_deduplicate)
         {
-            // Skip empty lines or line already seen, do not add
-            return false;
+            for (std::string_view line : lines)
+            {
+                // Skip empty lines or line already seen, do not add
+                if (std::optional<std::string_view> stored;
+                    !line.empty() && (stored = m_seenLines.insert(line)))
+                {
+                    batch.push_back(Line{*stored, CharMask::fromString(line)});
+                }
+            }
         }
-        std::scoped_lock lock(m_mutex);
-        m_seenLines.insert(hashValue);  // Insert line into seen set
-        // Notify subscribers about the update
-        onUpdate(ReadStatus::Continue, line);
-        return true;
+        else
+        {
+            std::scoped_lock lock(m_storeMutex);
+            for (std::string_view line : lines)
+            {
+                if (!line.empty())
+                {
+                    const std::string_view stored = m_lines[m_lines.append(line)];
+                    batch.push_back(Line{stored, CharMask::fromString(line)});
+                }
+            }
+        }
+        m_seenCount += batch.size();
+        if (!batch.empty())
+        {
+            // A reader that keeps watching its input may still be adding after disconnect().
+            std::scoped_lock lock(m_mutex);
+            if (onUpdate)
+            {
+                onUpdate(ReadStatus::Continue, batch);  // Notify subscribers about the update
+            }
+        }
+        return batch.size();
     }
 
+    /// @brief Removes lines added earlier, and notifies onRemove once with those removed.  A
+    /// removed line is added again by the next addLines() or addLine() that passes it.
+    /// @param lines The lines to remove; lines not added are skipped.
+    /// @return The number of lines removed.
+    std::size_t removeLines(std::span<const std::string_view> lines)
+    {
+        std::vector<std::string_view> removed;
+        removed.reserve(lines.size());
+        for (std::string_view line : lines)
+        {
+            if (!line.empty() && (!m_deduplicate || m_seenLines.erase(line)))
+            {
+                removed.push_back(line);
+            }
+        }
+        if (m_deduplicate)
+        {
+            m_seenCount -= removed.size();
+        }
+        if (!removed.empty())
+        {
+            std::scoped_lock lock(m_mutex);
+            if (onRemove)
+            {
+                onRemove(removed);
+            }
+        }
+        return removed.size();
+    }
+
+    /// @brief Adds a line if it is non-empty and not already seen, notifying listeners at once
+    /// with a batch of one.
+    /// @param line The line to add.
+    /// @return true if the line was added, false otherwise.
+    bool addLine(std::string_view line) { return addLines(std::span(&line, 1)) == 1; }
+
     void setEndOfFile()
     {
         std::scoped_lock lock(m_mutex);
         m_status = ReadStatus::EndOfFile;  // Set status to End of File
-        onUpdate(m_status, "");            // Notify subscribers about the end of file
+        if (onUpdate)
+        {
+            onUpdate(m_status, {});  // Notify subscribers about the end of file
+        }
     }
 
-    /// @brief Signal emitted when a new line is added, passing the current status and the new line.
-    std::function<void(ReadStatus, std::string)> onUpdate;
+    /// @brief Signal emitted when lines are added, passing the current status and the new lines.
+    /// The end of the input is signalled with an empty batch.
+    std::function<void(ReadStatus, Batch)> onUpdate;
+
+    /// @brief Signal emitted when lines are removed, passing the lines, each of which was passed
+    /// to onUpdate before.  Without deduplication, every copy of the line is meant.
+    std::function<void(std::span<const std::string_view>)> onRemove;
 
    private:
     mutable std::mutex m_mutex;                   ///< Mutex to protect access to internal state.
     ReadStatus m_status = ReadStatus::Continue;   ///< Current read status.
-    //std::unordered_set<std::string> m_seenLines;  ///< Set to track seen lines.
-    std::hash<std::string> m_hash{};
-    std::unordered_set<std::size_t> m_seenLines;  ///< Set to track seen lines.
+    LineSet m_seenLines;                          ///< Set to track seen lines.
+    bool m_deduplicate{true};                     ///< Whether m_seenLines is used.
+    std::mutex m_storeMutex;                      ///< Guards m_lines.
+    LineArena m_lines;                            ///< The lines added, without deduplication.
+    std::atomic<std::size_t> m_seenCount{0};      ///< Returned by seenCount().
 };
 
 }  // namespace fzf
@@ -0,0 +1,325 @@
+/// @file SmithWatermanSimd.cpp
+/// @brief Implementation of the scalar and vectorized Smith-Waterman kernels.
+///
+/// The vector kernels are compiled with per-function target attributes so that the binary runs on
+/// any x86-64 CPU; the best kernel is picked at runtime with detectLevel().
+
+#include "SmithWatermanSimd.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define FZF_SIMD_X86 1
+#include <immintrin.h>
+#endif
+
+namespace fzf::simd
+{
+
+namespace
+{
+
+/// Scores are bounded by 2 * min(len1, len2); beyond this the 16-bit lanes could saturate.
+constexpr std::size_t kMaxVectorLength = 16000;
+
+/// Line columns outside of the line hold this value, which never equals a byte or a query lane.
+constexpr int16_t kNoColumn = 0x200;
+
+bool useScalar(const QueryProfile& query, std::string_view line)
+{
+    return std::min(query.size(), line.size()) > kMaxVectorLength;
+}
+
+}  // namespace
+
+void QueryProfile::assign(std::string_view query)
+{
+    m_query.assign(query);
+
+    const std::size_t m = query.size();
+    m_substitution.resize(256 * m);
+    for (std::size_t c = 0; c < 256; ++c)
+    {
+        for (std::size_t i = 0; i < m; ++i)
+        {
+            m_substitution[c * m + i] = (static_cast<unsigned char>(query[i]) == c) ? 2 : -1;
+        }
+    }
+
+    const std::size_t padded = (m + kLanes - 1) / kLanes * kLanes;
+    m_lanes.assign(padded, kPaddingChar);
+    m_valid.assign(padded, 0);
+    for (std::size_t i = 0; i < m; ++i)
+    {
+        m_lanes[i] = static_cast<unsigned char>(query[i]);
+        m_valid[i] = -1;
+    }
+}
+
+int smithWatermanScalar(const QueryProfile& query, std::string_view line)
+{
+    // Swept column by column over the line so that the inner loop walks the query with a
+    // contiguous, branch-free row of the substitution profile.  The recurrence is symmetric, so
+    // this gives the same score as the row-major formulation.
+    const std::size_t len1 = query.size();
+
+    // Single rolling column: col[i] holds dp[i][j - 1] until row i of column j is computed.
+    thread_local std::vector<int> col;
+    col.assign(len1 + 1, 0);
+
+    int maxScore = 0;
+
+    for (char c : line)
+    {
+        const int8_t* match = query.substitution(c);
+        int diag = 0;  // dp[i - 1][j - 1]
+        int up = 0;    // dp[i - 1][j]
+        for (std::size_t i = 1; i <= len1; ++i)
+        {
+            int left = col[i];  // dp[i][j - 1]
+            up = std::max({0, diag + match[i - 1], left - 1, up - 1});
+            col[i] = up;
+            diag = left;
+            maxScore = std::max(maxScore, up);
+        }
+    }
+
+    return maxScore;
+}
+
+#ifdef FZF_SIMD_X86
+
+// The recurrence for a stripe of W query rows at line column j is
+//
+//   H[i][j] = max(0, H[i-1][j-1] + match(i, j), H[i][j-1] - 1, H[i-1][j] - 1)
+//
+// Everything except the last term only depends on column j - 1, so it is computed for the whole
+// stripe at once.  The vertical term is then resolved with a max-scan over the lanes
+// (H[i] = max(H[i], H[i-k] - k) for k = 1, 2, 4, ...).  The bottom row of each stripe is kept in
+// `boundary`, which acts as row 0 of the next stripe.
+
+#pragma GCC push_options
+#pragma GCC target("sse4.1")
+
+namespace
+{
+
+inline __m128i shiftLanesSse41(__m128i v, int16_t first)
+{
+    return _mm_insert_epi16(_mm_slli_si128(v, 2), first, 0);
+}
+
+}  // namespace
+
+int smithWatermanSse41(const QueryProfile& query, std::string_view line)
+{
+    constexpr std::size_t W = 8;
+    if (query.size() == 0 || line.empty())
+    {
+        return 0;
+    }
+    if (useScalar(query, line))
+    {
+        return smithWatermanScalar(query, line);
+    }
+
+    const std::size_t len2 = line.size();
+    thread_local std::vector<int16_t> boundary;
+    boundary.assign(len2 + 1, 0);
+
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set1_epi16(1);
+    const __m128i two = _mm_set1_epi16(2);
+    const __m128i four = _mm_set1_epi16(4);
+    const __m128i three = _mm_set1_epi16(3);
+    const __m128i ramp = _mm_setr_epi16(1, 2, 3, 4, 5, 6, 7, 8);
+    __m128i maxScore = zero;
+
+    for (std::size_t row = 0; row < query.size(); row += W)
+    {
+        const __m128i queryVec = _mm_loadu_si128(reinterpret_cast<const __m128i*>(query.lanes() + row));
+        const __m128i validVec = _mm_loadu_si128(reinterpret_cast<const __m128i*>(query.valid() + row));
+
+        __m128i h = zero;
+        int16_t diagAbove = boundary[0];
+        for (std::size_t j = 1; j <= len2; ++j)
+        {
+            const int16_t above = boundary[j];
+            const __m128i c = _mm_set1_epi16(static_cast<unsigned char>(line[j - 1]));
+            // 2 on a match, -1 otherwise
+            const __m128i match = _mm_sub_epi16(_mm_and_si128(_mm_cmpeq_epi16(queryVec, c), three), one);
+
+            __m128i next = _mm_max_epi16(zero, _mm_adds_epi16(shiftLanesSse41(h, diagAbove), match));
+            next = _mm_max_epi16(next, _mm_subs_epi16(h, one));
+            next = _mm_max_epi16(next, _mm_subs_epi16(_mm_set1_epi16(above), ramp));
+            next = _mm_max_epi16(next, _mm_subs_epi16(_mm_slli_si128(next, 2), one));
+            next = _mm_max_epi16(next, _mm_subs_epi16(_mm_slli_si128(next, 4), two));
+            next = _mm_max_epi16(next, _mm_subs_epi16(_mm_slli_si128(next, 8), four));
+
+            h = next;
+            maxScore = _mm_max_epi16(maxScore, _mm_and_si128(h, validVec));
+            boundary[j] = static_cast<int16_t>(_mm_extract_epi16(h, W - 1));
+            diagAbove = above;
+        }
+    }
+
+    alignas(16) int16_t lanes[W];
+    _mm_store_si128(reinterpret_cast<__m128i*>(lanes), maxScore);
+    return *std::max_element(lanes, lanes + W);
+}
+
+#pragma GCC pop_options
+
+#pragma GCC push_options
+#pragma GCC target("avx2")
+
+// The AVX2 kernel processes two 8-row stripes per sweep, one in each 128-bit half, so that every
+// lane shift stays within a half (cross-half shuffles would sit on the column-to-column critical
+// path).  Stripe B (the rows below stripe A) runs one column behind: at step t the low half
+// computes column t of A and the high half computes column t - 1 of B, whose "row above" is the
+// bottom lane of A from the previous step.  Queries that fit in a single stripe gain nothing from
+// the second half and are handed to the SSE4.1 kernel.
+
+int smithWatermanAvx2(const QueryProfile& query, std::string_view line)
+{
+    constexpr std::size_t W = 8;  // rows per stripe; two stripes per vector
+    if (query.size() <= W)
+    {
+        return smithWatermanSse41(query, line);
+    }
+    if (line.empty())
+    {
+        return 0;
+    }
+    if (useScalar(query, line))
+    {
+        return smithWatermanScalar(query, line);
+    }
+
+    const std::size_t len2 = line.size();
+    // One extra slot: the upper stripe runs one column past the end during the final step.
+    thread_local std::vector<int16_t> boundary;
+    boundary.assign(len2 + 2, 0);
+
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i one = _mm256_set1_epi16(1);
+    const __m256i two = _mm256_set1_epi16(2);
+    const __m256i four = _mm256_set1_epi16(4);
+    const __m256i three = _mm256_set1_epi16(3);
+    const __m256i ramp = _mm256_setr_epi16(1, 2, 3, 4, 5, 6, 7, 8, 1, 2, 3, 4, 5, 6, 7, 8);
+    __m256i maxScore = zero;
+
+    // Line character for column t, or a value that never matches outside of [1, len2].
+    auto column = [&](std::size_t t) -> int16_t
+    { return (t >= 1 && t <= len2) ? static_cast<unsigned char>(line[t - 1]) : kNoColumn; };
+
+    for (std::size_t row = 0; row < query.size(); row += 2 * W)
+    {
+        const __m256i queryVec =
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(query.lanes() + row));
+        const __m256i validVec =
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(query.valid() + row));
+
+        __m256i h = zero;
+        int16_t diagAbove = boundary[0];  // row above stripe A, column t - 1
+        int16_t bottomA = 0;              // bottom of stripe A, column t - 1
+        int16_t diagA = 0;                // bottom of stripe A, column t - 2
+        for (std::size_t t = 1; t <= len2 + 1; ++t)
+        {
+            const int16_t above = boundary[t];
+            const __m256i c = _mm256_inserti128_si256(
+                _mm256_castsi128_si256(_mm_set1_epi16(column(t))), _mm_set1_epi16(column(t - 1)), 1);
+            // 2 on a match, -1 otherwise
+            const __m256i match =
+                _mm256_sub_epi16(_mm256_and_si256(_mm256_cmpeq_epi16(queryVec, c), three), one);
+
+            __m256i diag = _mm256_slli_si256(h, 2);
+            diag = _mm256_insert_epi16(diag, diagAbove, 0);
+            diag = _mm256_insert_epi16(diag, diagA, 8);
+            const __m256i aboveVec = _mm256_inserti128_si256(
+                _mm256_castsi128_si256(_mm_set1_epi16(above)), _mm_set1_epi16(bottomA), 1);
+
+            __m256i next = _mm256_max_epi16(zero, _mm256_adds_epi16(diag, match));
+            next = _mm256_max_epi16(next, _mm256_subs_epi16(h, one));
+            next = _mm256_max_epi16(next, _mm256_subs_epi16(aboveVec, ramp));
+            next = _mm256_max_epi16(next, _mm256_subs_epi16(_mm256_slli_si256(next, 2), one));
+            next = _mm256_max_epi16(next, _mm256_subs_epi16(_mm256_slli_si256(next, 4), two));
+            next = _mm256_max_epi16(next, _mm256_subs_epi16(_mm256_slli_si256(next, 8), four));
+
+            h = next;
+            // Cells of the phantom columns (0 for B, len2 + 1 for A) never exceed a real cell, so
+            // they do not need to be masked out of the running maximum.
+            maxScore = _mm256_max_epi16(maxScore, _mm256_and_si256(h, validVec));
+            boundary[t - 1] = static_cast<int16_t>(_mm256_extract_epi16(h, 2 * W - 1));
+            diagA = bottomA;
+            bottomA = static_cast<int16_t>(_mm256_extract_epi16(h, W - 1));
+            diagAbove = above;
+        }
+    }
+
+    alignas(32) int16_t lanes[2 * W];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), maxScore);
+    return *std::max_element(lanes, lanes + 2 * W);
+}
+
+#pragma GCC pop_options
+
+Level detectLevel()
+{
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        return Level::AVX2;
+    }
+    if (__builtin_cpu_supports("sse4.1"))
+    {
+        return Level::SSE41;
+    }
+    return Level::Scalar;
+}
+
+#else  // FZF_SIMD_X86
+
+int smithWatermanSse41(const QueryProfile& query, std::string_view line)
+{
+    return smithWatermanScalar(query, line);
+}
+
+int smithWatermanAvx2(const QueryProfile& query, std::string_view line)
+{
+    return smithWatermanScalar(query, line);
+}
+
+Level detectLevel() { return Level::Scalar; }
+
+#endif  // FZF_SIMD_X86
+
+bool isSupported(Level level)
+{
+    switch (detectLevel())
+    {
+        case Level::AVX2:
+            return true;
+        case Level::SSE41:
+            return level != Level::AVX2;
+        default:
+            return level == Level::Scalar;
+    }
+}
+
+SmithWatermanKernel kernel(Level level)
+{
+    switch (level)
+    {
+        case Level::AVX2:
+            return &smithWatermanAvx2;
+        case Level::SSE41:
+            return &smithWatermanSse41;
+        default:
+            return &smithWatermanScalar;
+    }
+}
+
+}  // namespace fzf::simd
@@ -1,8 +1,12 @@
 #include "StdinReader.h"
 
+#include <unistd.h>
+
 #include <boost/asio/read_until.hpp>
 #include <string>
 
+#include "BlockReader.h"
+
 namespace fzf
 {
 
@@ -28,12 +32,17 @@ void StdinReader::stop()
 
 void StdinReader::read()
 {
-    std::string line;
-    while (std::getline(std::cin, line) && !m_stop)
-    {
-        addLine(line);  // Add the line to the internal storage
-    }
-    if (m_stop)
+    // Raw blocks from the descriptor rather than std::getline() through the synced std::cin.
+    BlockReader reader(STDIN_FILENO);
+    bool finished = reader.run(m_stop,
+                               [this](BlockReader::Batch lines)
+                               {
+                                   if (!m_stop)
+                                   {
+                                       addLines(lines);  // Add the lines to the internal storage
+                                   }
+                               });
+    if (!finished || m_stop)
     {
         // Exit if stop was requested
         return;
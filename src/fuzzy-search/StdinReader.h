@@ -13,8 +13,9 @@ namespace fzf
 /// @class fzf::StdinReader
 /// @brief Reads lines asynchronously from standard input for fuzzy search.
 ///
-/// Inherits from fzf::Reader. Launches a background thread to read lines from stdin,
-/// adding each unique, non-empty line to the input set and notifying listeners.
+/// Inherits from fzf::Reader. Launches a background thread to read lines from stdin in large
+/// blocks (see BlockReader), adding each unique, non-empty line to the input set and notifying
+/// listeners.
 /// Thread-safe and supports start/stop control.
 class StdinReader : public Reader
 {
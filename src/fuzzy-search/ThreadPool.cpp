@@ -0,0 +1,161 @@
+/// @file ThreadPool.cpp
+/// @brief Implementation of the ThreadPool class.
+
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace fzf
+{
+
+ThreadPool::ThreadPool(std::size_t threads)
+{
+    threads = std::max<std::size_t>(threads, 1);
+    for (std::size_t i = 0; i < threads; ++i)
+    {
+        m_queues.push_back(std::make_unique<Queue>());
+    }
+    for (std::size_t i = 1; i < threads; ++i)
+    {
+        m_workers.emplace_back([this, i]() { work(i); });
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::scoped_lock lock(m_mutex);
+        m_stop = true;
+    }
+    m_wake.notify_all();
+    for (auto& worker : m_workers)
+    {
+        worker.join();
+    }
+}
+
+void ThreadPool::parallelFor(std::size_t count, const std::function<void(std::size_t)>& body)
+{
+    if (count == 0)
+    {
+        return;
+    }
+    if (m_workers.empty() || count == 1)
+    {
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            body(i);
+        }
+        return;
+    }
+
+    std::scoped_lock loopLock(m_loopMutex);
+    {
+        std::scoped_lock lock(m_mutex);
+        m_body = &body;
+        m_error = nullptr;
+        m_remaining = count;
+    }
+    // Deal out contiguous blocks, so that each thread starts on neighbouring iterations.
+    const std::size_t threads = m_queues.size();
+    for (std::size_t t = 0; t < threads; ++t)
+    {
+        std::scoped_lock lock(m_queues[t]->mutex);
+        for (std::size_t i = t * count / threads; i < (t + 1) * count / threads; ++i)
+        {
+            m_queues[t]->indices.push_back(i);
+        }
+    }
+    {
+        std::scoped_lock lock(m_mutex);
+        ++m_loop;
+    }
+    m_wake.notify_all();
+
+    while (runOne(0))
+    {
+    }
+
+    std::unique_lock lock(m_mutex);
+    m_done.wait(lock, [this]() { return m_remaining == 0; });
+    m_body = nullptr;
+    if (m_error)
+    {
+        std::rethrow_exception(std::exchange(m_error, nullptr));
+    }
+}
+
+void ThreadPool::work(std::size_t self)
+{
+    std::uint64_t seen = 0;
+    while (true)
+    {
+        {
+            std::unique_lock lock(m_mutex);
+            m_wake.wait(lock, [&]() { return m_stop || m_loop != seen; });
+            if (m_stop)
+            {
+                return;
+            }
+            seen = m_loop;
+        }
+        while (runOne(self))
+        {
+        }
+    }
+}
+
+bool ThreadPool::runOne(std::size_t self)
+{
+    std::size_t index = 0;
+    bool found = false;
+    {
+        Queue& own = *m_queues[self];
+        std::scoped_lock lock(own.mutex);
+        if (!own.indices.empty())
+        {
+            index = own.indices.front();
+            own.indices.pop_front();
+            found = true;
+        }
+    }
+    for (std::size_t k = 1; !found && k < m_queues.size(); ++k)
+    {
+        Queue& victim = *m_queues[(self + k) % m_queues.size()];
+        std::scoped_lock lock(victim.mutex);
+        if (!victim.indices.empty())
+        {
+            index = victim.indices.back();
+            victim.indices.pop_back();
+            found = true;
+        }
+    }
+    if (!found)
+    {
+        return false;
+    }
+
+    // m_body stays valid until the last iteration has finished, which cannot happen before this
+    // one does.
+    try
+    {
+        (*m_body)(index);
+    }
+    catch (...)
+    {
+        std::scoped_lock lock(m_mutex);
+        if (!m_error)
+        {
+            m_error = std::current_exception();
+        }
+    }
+    if (--m_remaining == 0)
+    {
+        std::scoped_lock lock(m_mutex);
+        m_done.notify_all();
+    }
+    return true;
+}
+
+}  // namespace fzf
@@ -0,0 +1,83 @@
+/// @file ThreadPool.h
+/// @brief Persistent work-stealing thread pool for data-parallel loops.
+
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace fzf
+{
+
+/// @class ThreadPool
+/// @brief A fixed set of worker threads that run the iterations of parallelFor().
+///
+/// Each thread (the caller of parallelFor() included) owns a queue of iteration indices, filled
+/// with a contiguous block of the iteration range.  A thread works through its own queue from the
+/// front and, once it is empty, steals from the back of the other queues, so uneven iterations
+/// (e.g. chunks of long lines) are balanced without a shared queue on the fast path.  The threads
+/// are started once and sleep between loops.
+class ThreadPool
+{
+   public:
+    /// @brief Start the pool.
+    /// @param threads Number of threads running each loop, the caller included; 0 and 1 both run
+    /// loops on the calling thread only.
+    explicit ThreadPool(std::size_t threads);
+    /// @brief Destructor. Stops and joins the worker threads.
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /// @brief Number of threads running each loop, the caller included.
+    std::size_t size() const { return m_queues.size(); }
+
+    /// @brief Run body(i) for every i in [0, count) and wait for all of them to finish.
+    ///
+    /// Iterations may run concurrently and in any order.  If an iteration throws, the first
+    /// exception is rethrown here once the loop has finished.  Loops started from different
+    /// threads run one after the other.
+    void parallelFor(std::size_t count, const std::function<void(std::size_t)>& body);
+
+   private:
+    /// @brief Iteration indices owned by one thread.
+    struct Queue
+    {
+        std::mutex mutex;
+        std::deque<std::size_t> indices;
+    };
+
+    /// @brief Main loop of worker thread `self`.
+    void work(std::size_t self);
+    /// @brief Run one iteration of the current loop, from queue `self` or stolen from another.
+    /// @return false if there was nothing left to run.
+    bool runOne(std::size_t self);
+
+    std::vector<std::unique_ptr<Queue>> m_queues;  ///< One per thread; 0 belongs to the caller.
+    std::vector<std::thread> m_workers;            ///< Worker threads 1 .. size() - 1.
+
+    std::mutex m_loopMutex;          ///< Serializes parallelFor() calls.
+    std::mutex m_mutex;              ///< Guards the members below.
+    std::condition_variable m_wake;  ///< Signals workers that a loop started or the pool stops.
+    std::condition_variable m_done;  ///< Signals the caller that the loop finished.
+    const std::function<void(std::size_t)>* m_body{nullptr};  ///< Body of the current loop.
+    std::atomic<std::size_t> m_remaining{0};  ///< Iterations of the current loop not finished.
+    std::uint64_t m_loop{0};                  ///< Number of loops started.
+    std::exception_ptr m_error;               ///< First exception thrown by the current loop.
+    bool m_stop{false};                       ///< Set when the pool is destroyed.
+};
+
+}  // namespace fzf
+
+#endif  // THREADPOOL_H
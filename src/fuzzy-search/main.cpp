@@ -1,13 +1,16 @@
 /// @file FuzzySearchApp.cpp
 /// @brief Application to perform fuzzy search using Levenshtein distance.
 
+#include <algorithm>
 #include <boost/algorithm/string.hpp>
 #include <boost/asio/io_context.hpp>
 #include <boost/program_options.hpp>
 #include <iostream>
 #include <string>
+#include <thread>
 
 #include "Application.h"
+#include "BatchFilter.h"
 #include "Controller.h"
 #include "InputReaderFactory.h"
 #include "JSONRPCInterface.h"
@@ -32,9 +35,29 @@ po::variables_map parseCommandLineOptions(int argc, char* argv[])
         ("files,F",  "File listing, recursive from search root")
         ("directories,D", "Directory listing, recursive from the search root")
         ("search-root", po::value<std::string>()->default_value("."), "Root path for file/directory search")
+        ("walk-threads", po::value<unsigned>()->default_value(fzf::FileListReader::kDefaultThreads),
+            "Number of threads reading directories for --files and --directories")
+        ("no-ignore", "List what .gitignore, .ignore and git's excludes files ignore, for --files and --directories")
+        ("index", "Start from the listing saved by the previous run of --files or --directories for the same "
+            "search root, then update it by reading only the directories that changed")
+        ("watch", "Keep --files and --directories up to date with the files created and deleted "
+            "under the search root (Linux)")
         ("reverse,R", "Reverse the sorting order of results")
         ("results,r", po::value<int>()->default_value(10), "Number of possible results")
-        ("jsonrpc,j", "Use JSON-RPC for input/output");
+        ("scorer", po::value<std::string>()->default_value("smith-waterman"),
+            "Scoring algorithm: smith-waterman or smith-waterman-levenshtein")
+        ("cache-size",
+            po::value<std::size_t>()->default_value(Application::kDefaultCacheBytes >> 20),
+            "Memory budget of the per-query result cache, in MiB (0 disables it)")
+        ("no-dedup", "Keep duplicate input lines (saves time and memory for inputs known to be unique)")
+        ("threads", po::value<unsigned>()->default_value(std::max(1u, std::thread::hardware_concurrency())),
+            "Number of threads scoring lines")
+        ("fps", po::value<unsigned>()->default_value(Application::kDefaultFps),
+            "Maximum number of times per second the results are redrawn (0: no limit)")
+        ("jsonrpc,j", "Use JSON-RPC for input/output")
+        ("filter", "Print the lines matching --search to standard output, best first, and exit; no terminal is used")
+        ("limit", po::value<std::size_t>(), "With --filter, print at most this many lines")
+        ("stats", "With --filter, report the number of lines and lines per second on standard error");
     // clang-format on
 
     po::variables_map vm;
@@ -60,6 +83,25 @@ po::variables_map parseCommandLineOptions(int argc, char* argv[])
     return vm;
 }
 
+/// @brief Runs --filter: ranks the whole input and prints the matches, without a terminal.
+/// @return The exit status: success if any line matched, as with grep.
+int runFilter(const po::variables_map& vm, fzf::Reader& inputReader, fzf::Scorer scorer,
+              unsigned threads)
+{
+    std::size_t limit =
+        vm.count("limit") ? vm["limit"].as<std::size_t>() : fzf::BatchFilter::kNoLimit;
+    fzf::BatchFilter filter(vm["search"].as<std::string>(), scorer, threads, limit);
+    std::ios::sync_with_stdio(false);  // Output goes out in blocks; no need to interleave
+    fzf::BatchFilter::Stats stats = filter.run(inputReader, std::cout);
+    if (vm.count("stats"))
+    {
+        std::cerr << stats.lines << " lines, " << stats.matches << " matches, " << stats.printed
+                  << " printed in " << stats.elapsed.count() << " s ("
+                  << static_cast<std::size_t>(stats.linesPerSecond()) << " lines/s)" << std::endl;
+    }
+    return stats.matches > 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
 std::unique_ptr<fzf::InputInterface> createInputInterface(const po::variables_map& vm)
 {
     if (vm.count("jsonrpc"))
@@ -82,15 +124,31 @@ int main(int argc, char* argv[])
         po::variables_map vm = parseCommandLineOptions(argc, argv);
         std::string searchString = vm["search"].as<std::string>();
         int numResults = vm["results"].as<int>();
+        fzf::Scorer scorer = fzf::parseScorer(vm["scorer"].as<std::string>());
+        std::size_t cacheBytes = vm["cache-size"].as<std::size_t>() << 20;
+        unsigned threads = vm["threads"].as<unsigned>();
+        unsigned fps = vm["fps"].as<unsigned>();
         std::string resultBase{};
 
-        auto tty = createInputInterface(vm);
         fzf::Reader::Ptr inputReader = fzf::createInputReader(vm, ioContext);
-        Application app(searchString, inputReader, *tty, numResults);
-        fzf::Controller controller(*tty, app);
-        inputReader->start();
-        controller.run();
-        tty->writeFinalResult(app.result());
+        inputReader->setDeduplicate(vm.count("no-dedup") == 0);
+        if (vm.count("filter"))
+        {
+            return runFilter(vm, *inputReader, scorer, threads);
+        }
+
+        auto tty = createInputInterface(vm);
+        std::string result;
+        {
+            Application app(searchString, inputReader, *tty, numResults, scorer, cacheBytes,
+                            threads, fps);
+            fzf::Controller controller(*tty, app);
+            inputReader->start();
+            controller.run();
+            app.waitForSearch();  // Enter may arrive before the last keystroke's search completes
+            result = app.result();
+        }  // Stops the render thread, which would otherwise race the final write
+        tty->writeFinalResult(result);
         return EXIT_SUCCESS;
     }
     catch (const std::exception& e)
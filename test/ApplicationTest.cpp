@@ -0,0 +1,223 @@
+// @file ApplicationTest.cpp
+// @brief Unit tests for the Application's input pipeline and rendering.
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "Application.h"
+#include "CompiledQuery.h"
+using namespace fzf;
+
+namespace {
+/// A reader whose lines are added by the test.
+struct TestReader : Reader
+{
+    void start() override {}
+
+    /// Add count lines named after prefix.
+    void add(const std::string& prefix, std::size_t count)
+    {
+        std::vector<std::string> lines;
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            lines.push_back(prefix + std::to_string(i));
+        }
+        std::vector<std::string_view> views(lines.begin(), lines.end());
+        addLines(views);
+    }
+
+    /// Take back a line added earlier.
+    void remove(std::string_view line) { removeLines(std::span(&line, 1)); }
+};
+
+/// A line made of query over and over, long enough that scoring it for query takes at least
+/// cost: while the score stage is busy with it, the deltas queued after it wait.
+std::string slowLine(const std::string& query, std::chrono::milliseconds cost)
+{
+    const CompiledQuery compiled(query);
+    std::string line;
+    while (line.size() < (1 << 20))
+    {
+        line += query + " ";
+    }
+    while (true)
+    {
+        const auto started = std::chrono::steady_clock::now();
+        compiled.score(line, CharMask::fromString(line));
+        if (std::chrono::steady_clock::now() - started >= cost)
+        {
+            return line;
+        }
+        line += line;
+    }
+}
+
+/// Counts the redraws, and keeps the last results drawn.
+class CountingInput : public InputInterface
+{
+   public:
+    InputEvent getNextEvent() override { return {}; }
+    void writeResults(const Results& results) override
+    {
+        std::scoped_lock lock(m_mutex);
+        ++m_writes;
+        m_last = results;
+    }
+    void updateProgress(size_t) override {}
+    void writeFinalResult(const std::string&) override {}
+
+    int writes() const
+    {
+        std::scoped_lock lock(m_mutex);
+        return m_writes;
+    }
+    Results last() const
+    {
+        std::scoped_lock lock(m_mutex);
+        return m_last;
+    }
+
+   private:
+    mutable std::mutex m_mutex;
+    int m_writes{0};
+    Results m_last;
+};
+}  // namespace
+
+TEST(ApplicationTest, RedrawsAtMostFpsTimesPerSecond)
+{
+    constexpr unsigned kFps = 10;
+    constexpr auto kFrame = std::chrono::milliseconds(1000 / kFps);
+    auto* reader = new TestReader;
+    Reader::Ptr input(reader);
+    std::string search;
+    CountingInput tty;
+    Application app(search, input, tty, 10, Scorer::SmithWaterman, 0, 1, kFps);
+
+    // A burst of small batches is drawn a bounded number of times, ending with all of it.
+    const auto started = std::chrono::steady_clock::now();
+    for (int batch = 0; batch < 100; ++batch)
+    {
+        reader->add("/batch" + std::to_string(batch) + "/", 20);
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    app.waitForInput();
+    const auto elapsed = std::chrono::steady_clock::now() - started;
+    std::this_thread::sleep_for(3 * kFrame);
+    const int frames = tty.writes();
+    EXPECT_GE(frames, 1);
+    EXPECT_LE(frames, elapsed / kFrame + 2);
+    EXPECT_EQ(tty.last().totalResults, 2000u);
+
+    // Snapshots that change nothing on screen are not drawn: a selection left where it is, and
+    // lines the query rejects.
+    app.setSearchString("zzz");
+    app.waitForSearch();
+    std::this_thread::sleep_for(3 * kFrame);
+    const int before = tty.writes();
+    EXPECT_EQ(tty.last().searchString, "zzz");
+    app.setSelectedIndex(app.getSelectedIndex());
+    reader->add("/other/", 500);
+    app.waitForInput();
+    std::this_thread::sleep_for(3 * kFrame);
+    EXPECT_EQ(tty.writes(), before);
+}
+
+TEST(ApplicationTest, FullPipelineHoldsBackTheReader)
+{
+    constexpr auto kStall = std::chrono::milliseconds(100);
+    constexpr std::size_t kLines = 500;
+    auto* reader = new TestReader;
+    Reader::Ptr input(reader);
+    std::string search = "needle";
+    CountingInput tty;
+    Application app(search, input, tty, 10);
+    const std::string slow = slowLine(search, kStall);
+
+    // While the score stage is busy with the slow line, the reader only gets as far as the
+    // queues hold; unbounded queues would take all the lines at once.
+    const auto started = std::chrono::steady_clock::now();
+    ASSERT_TRUE(reader->addLine(slow));
+    std::size_t early = 0;
+    for (std::size_t i = 0; i < kLines; ++i)
+    {
+        reader->addLine("/needle/" + std::to_string(i));
+        if (std::chrono::steady_clock::now() - started < kStall / 2)
+        {
+            ++early;
+        }
+    }
+    EXPECT_LE(early, 2 * Application::kQueueCapacity);
+
+    // Nothing is lost by waiting.
+    app.waitForInput();
+    EXPECT_EQ(app.size(), kLines + 1);
+}
+
+TEST(ApplicationTest, RescoresLinesScoredForAReplacedQuery)
+{
+    constexpr auto kStall = std::chrono::milliseconds(100);
+    constexpr unsigned kFps = 100;
+    auto* reader = new TestReader;
+    Reader::Ptr input(reader);
+    std::string search = "needle";
+    CountingInput tty;
+    Application app(search, input, tty, 10, Scorer::SmithWaterman, 0, 1, kFps);
+    const std::string slow = slowLine(search, kStall);
+
+    // The slow line is scored for "needle", which it matches; the query changes while it is.
+    ASSERT_TRUE(reader->addLine(slow));
+    reader->add("/needle/file", 100);
+    std::this_thread::sleep_for(kStall / 4);
+    app.setSearchString("file");
+    app.waitForSearch();
+    app.waitForInput();
+
+    // Merged, it is scored for "file", which it does not match.
+    EXPECT_EQ(app.size(), 100u);
+    std::this_thread::sleep_for(std::chrono::milliseconds(3 * 1000 / kFps));
+    const Results drawn = tty.last();
+    EXPECT_EQ(drawn.searchString, "file");
+    EXPECT_EQ(drawn.totalResults, 100u);
+    const CompiledQuery file("file");
+    ASSERT_FALSE(drawn.results.empty());
+    for (const Result& row : drawn.results)
+    {
+        EXPECT_EQ(row.score, file.score(row.line)) << row.line;
+    }
+}
+
+TEST(ApplicationTest, AppliesRemovalsInOrderWithAdditions)
+{
+    constexpr auto kStall = std::chrono::milliseconds(50);
+    auto* reader = new TestReader;
+    Reader::Ptr input(reader);
+    std::string search = "needle";
+    CountingInput tty;
+    Application app(search, input, tty, 10);
+
+    // Behind the slow line, each line reaches the merge stage with the removal that follows it.
+    ASSERT_TRUE(reader->addLine(slowLine(search, kStall)));
+    ASSERT_TRUE(reader->addLine("/needle/a"));
+    reader->remove("/needle/a");
+    ASSERT_TRUE(reader->addLine("/needle/b"));
+    reader->remove("/needle/b");
+    ASSERT_TRUE(reader->addLine("/needle/b"));
+    app.waitForInput();
+    EXPECT_EQ(app.size(), 2u);
+
+    app.setSearchString("needle/a");
+    app.waitForSearch();
+    EXPECT_EQ(app.size(), 0u);
+    app.setSearchString("needle/b");
+    app.waitForSearch();
+    EXPECT_EQ(app.size(), 1u);
+    EXPECT_EQ(app.result(), "/needle/b");
+}
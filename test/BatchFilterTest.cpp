@@ -0,0 +1,79 @@
+// @file BatchFilterTest.cpp
+// @brief Unit tests for the non-interactive BatchFilter.
+
+#include <gtest/gtest.h>
+
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "BatchFilter.h"
+#include "CompiledQuery.h"
+#include "Ranking.h"
+#include "Reader.h"
+#include "TestLines.h"
+using namespace fzf;
+using namespace fzf::test;
+
+TEST(BatchFilterTest, PrintsRankedMatches)
+{
+    struct Lines : Reader
+    {
+        std::vector<std::string> lines;
+        void start() override
+        {
+            std::vector<std::string_view> views(lines.begin(), lines.end());
+            addLines(views);
+            setEndOfFile();
+        }
+    };
+    auto paths = randomPaths(20000, 9);
+    auto filter = [&](const std::string& query, std::size_t limit)
+    {
+        Lines reader;
+        reader.lines = paths;
+        std::ostringstream out;
+        auto stats = BatchFilter(query, Scorer::SmithWaterman, 4, limit).run(reader, out);
+        return std::make_pair(stats, out.str());
+    };
+
+    auto split = [](const std::string& printed)
+    {
+        std::istringstream lines(printed);
+        std::vector<std::string> output;
+        for (std::string line; std::getline(lines, line);)
+        {
+            output.push_back(line);
+        }
+        return output;
+    };
+
+    // Every match, in rank order.
+    CompiledQuery query("abc");
+    auto [stats, printed] = filter("abc", BatchFilter::kNoLimit);
+    auto output = split(printed);
+    EXPECT_EQ(stats.printed, output.size());
+    EXPECT_EQ(stats.matches, output.size());
+    EXPECT_GT(stats.matches, 0u);
+    EXPECT_LE(stats.lines, paths.size());
+    for (std::size_t i = 1; i < output.size(); ++i)
+    {
+        EXPECT_FALSE(rankedBefore(makeCandidate(query, output[i]),
+                                  makeCandidate(query, output[i - 1])))
+            << i;
+    }
+
+    // With a limit, the best lines of the same ranking (ties may be broken either way).
+    auto [limitedStats, limited] = filter("abc", 10);
+    auto best = split(limited);
+    ASSERT_EQ(best.size(), 10u);
+    EXPECT_EQ(limitedStats.printed, 10u);
+    EXPECT_EQ(limitedStats.matches, stats.matches);
+    for (std::size_t i = 0; i < best.size(); ++i)
+    {
+        EXPECT_EQ(makeCandidate(query, best[i]).score, makeCandidate(query, output[i]).score);
+    }
+    EXPECT_EQ(filter("zzz", BatchFilter::kNoLimit).first.matches, 0u);
+}
@@ -0,0 +1,55 @@
+// @file BoundedQueueTest.cpp
+// @brief Unit tests for the BoundedQueue connecting the stages of the input pipeline.
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <optional>
+#include <thread>
+
+#include "BoundedQueue.h"
+using namespace fzf;
+
+TEST(BoundedQueueTest, BlocksWhileFull)
+{
+    BoundedQueue<int> queue(4);
+    ASSERT_EQ(queue.capacity(), 4u);
+    for (int i = 0; i < 4; ++i)
+    {
+        ASSERT_TRUE(queue.push(i));
+    }
+
+    // The producer waits for room: that is the backpressure.
+    std::atomic<int> pushed{4};
+    std::thread producer(
+        [&]()
+        {
+            for (int i = 4; i < 1000; ++i)
+            {
+                if (!queue.push(i))
+                {
+                    return;
+                }
+                ++pushed;
+            }
+        });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    EXPECT_EQ(pushed, 4);
+
+    for (int i = 0; i < 1000; ++i)
+    {
+        std::optional<int> item = queue.pop();
+        ASSERT_TRUE(item);
+        ASSERT_EQ(*item, i);
+    }
+    producer.join();
+    EXPECT_FALSE(queue.pop(std::chrono::milliseconds(1)));
+
+    // close() drains: what was pushed before still comes out, then nothing.
+    ASSERT_TRUE(queue.push(7));
+    queue.close();
+    EXPECT_FALSE(queue.push(8));
+    EXPECT_EQ(queue.pop(), 7);
+    EXPECT_FALSE(queue.pop());
+}
@@ -2,7 +2,16 @@
 // @brief Unit tests for the FuzzySearcher utility functions using Google Test.
 
 #include <gtest/gtest.h>
+
+#include <algorithm>
+#include <random>
+#include <stdexcept>
+#include <string_view>
+#include <vector>
+
+#include "CompiledQuery.h"
 #include "FuzzySearcher.h"
+#include "SmithWatermanSimd.h"
 using namespace fzf;
 
 TEST(FuzzySearcherTest, LevenshteinDistance) {
@@ -48,3 +57,155 @@ TEST(FuzzySearcherTest, SmithWaterman) {
     EXPECT_EQ(smithWaterman("abc", ""), 0);
     EXPECT_EQ(smithWaterman("", "abc"), 0);
 }
+
+namespace {
+std::string randomString(std::mt19937& gen, std::size_t maxLength, std::string_view alphabet)
+{
+    std::string s(gen() % (maxLength + 1), ' ');
+    for (auto& c : s)
+    {
+        c = alphabet[gen() % alphabet.size()];
+    }
+    return s;
+}
+}  // namespace
+
+TEST(FuzzySearcherTest, SimdSmithWatermanMatchesScalar) {
+    // Includes non-ASCII bytes so that signed/unsigned char handling is covered.
+    constexpr std::string_view alphabet = "abcAB/._-\xc3\xa9";
+    for (auto level : {simd::Level::SSE41, simd::Level::AVX2})
+    {
+        if (!simd::isSupported(level))
+        {
+            continue;
+        }
+        auto kernel = simd::kernel(level);
+        std::mt19937 gen(42);
+        for (int i = 0; i < 20000; ++i)
+        {
+            // Query lengths span several stripes so stripe boundaries are exercised.
+            std::string query = randomString(gen, 40, alphabet);
+            std::string line = randomString(gen, 120, alphabet);
+            simd::QueryProfile profile(query);
+            ASSERT_EQ(kernel(profile, line), simd::smithWatermanScalar(profile, line))
+                << "query='" << query << "' line='" << line << "'";
+        }
+        EXPECT_EQ(kernel(simd::QueryProfile("test"), "test"), 8);
+        EXPECT_EQ(kernel(simd::QueryProfile("abcdef"), "cde"), 6);
+        EXPECT_EQ(kernel(simd::QueryProfile(""), "abc"), 0);
+    }
+}
+
+TEST(FuzzySearcherTest, CompiledQueryMatchesScore) {
+    constexpr std::string_view alphabet = "abcAB/._-";
+    std::mt19937 gen(7);
+    for (int i = 0; i < 200; ++i)
+    {
+        CompiledQuery query(randomString(gen, 12, alphabet));
+        for (int j = 0; j < 50; ++j)
+        {
+            std::string line = randomString(gen, 80, alphabet);
+            ASSERT_EQ(query.score(line), score(query.query(), line))
+                << "query='" << query.query() << "' line='" << line << "'";
+        }
+    }
+    EXPECT_EQ(CompiledQuery("").score("anything"), 1);
+}
+
+TEST(FuzzySearcherTest, CharMaskPrefilter) {
+    CompiledQuery query("abc");
+    auto mask = [](std::string_view line) { return CharMask::fromString(line); };
+
+    EXPECT_TRUE(mask("xaybzc").covers(query.mask()));
+    EXPECT_FALSE(mask("xaybz").covers(query.mask()));
+    EXPECT_TRUE(mask("").covers(CompiledQuery("").mask()));
+
+    // Lines lacking a query character are rejected without being scored.
+    EXPECT_EQ(query.score("xaybz", mask("xaybz")), CompiledQuery::kNoMatch);
+    EXPECT_EQ(query.score("xaybzc", mask("xaybzc")), query.score("xaybzc"));
+    EXPECT_EQ(CompiledQuery("").score("abc", mask("abc")), 1);
+}
+
+TEST(FuzzySearcherTest, CompiledQueryAcceptsSubsequences) {
+    CompiledQuery query("abc");
+    auto accepts = [&](std::string_view line)
+    { return query.accepts(line, CharMask::fromString(line)); };
+
+    EXPECT_TRUE(accepts("abc"));
+    EXPECT_TRUE(accepts("xaybzc"));
+    EXPECT_FALSE(accepts("cba"));  // all characters present, but out of order
+    EXPECT_FALSE(accepts("ab"));
+    EXPECT_EQ(query.score("cba", CharMask::fromString("cba")), CompiledQuery::kNoMatch);
+    EXPECT_FALSE(CompiledQuery("aa").accepts("xa", CharMask::fromString("xa")));
+
+    EXPECT_TRUE(CompiledQuery("ab").isRefinedBy(CompiledQuery("abc")));
+    EXPECT_TRUE(CompiledQuery("ac").isRefinedBy(CompiledQuery("abc")));
+    EXPECT_TRUE(CompiledQuery("").isRefinedBy(CompiledQuery("abc")));
+    EXPECT_FALSE(CompiledQuery("abc").isRefinedBy(CompiledQuery("ab")));
+    EXPECT_FALSE(CompiledQuery("ab").isRefinedBy(CompiledQuery("ba")));
+}
+
+namespace {
+int referenceLevenshtein(std::string_view s1, std::string_view s2)
+{
+    std::vector<std::vector<int>> dp(s1.size() + 1, std::vector<int>(s2.size() + 1));
+    for (std::size_t i = 0; i <= s1.size(); ++i)
+    {
+        for (std::size_t j = 0; j <= s2.size(); ++j)
+        {
+            if (i == 0 || j == 0)
+            {
+                dp[i][j] = i + j;
+            }
+            else
+            {
+                dp[i][j] = std::min({dp[i - 1][j] + 1, dp[i][j - 1] + 1,
+                                     dp[i - 1][j - 1] + (s1[i - 1] == s2[j - 1] ? 0 : 1)});
+            }
+        }
+    }
+    return dp[s1.size()][s2.size()];
+}
+}  // namespace
+
+TEST(FuzzySearcherTest, BitParallelLevenshteinMatchesReference) {
+    constexpr std::string_view alphabet = "abcd/\xc3";
+    std::mt19937 gen(3);
+    for (int i = 0; i < 3000; ++i)
+    {
+        // Patterns up to 200 characters exercise the multi-word (blocked) variant.
+        std::string s1 = randomString(gen, i % 3 == 0 ? 200 : 64, alphabet);
+        std::string s2 = randomString(gen, 150, alphabet);
+        int expected = referenceLevenshtein(s1, s2);
+        ASSERT_EQ(levenshteinDistance(s1, s2), expected) << "s1='" << s1 << "' s2='" << s2 << "'";
+
+        int cutoff = gen() % 40;
+        int bounded = levenshteinDistanceBounded(s1, s2, cutoff);
+        ASSERT_EQ(bounded, expected <= cutoff ? expected : cutoff + 1)
+            << "s1='" << s1 << "' s2='" << s2 << "' cutoff=" << cutoff;
+    }
+}
+
+TEST(FuzzySearcherTest, SmithWatermanLevenshteinScorer) {
+    CompiledQuery query("fuzzy", Scorer::SmithWatermanLevenshtein);
+    // Exact when the result is a match ...
+    EXPECT_EQ(query.score("fuzzy"), smithWaterman("fuzzy", "fuzzy") - 0);
+    EXPECT_EQ(query.score("fuzy"), smithWaterman("fuzzy", "fuzy") - 1);
+    // ... and cut off at 0, not kNoMatch, when the distance outweighs the alignment.
+    EXPECT_EQ(query.score("src/fuzzy-search/main.cpp"), 0);
+    std::mt19937 gen(11);
+    for (int i = 0; i < 1000; ++i)
+    {
+        std::string line = randomString(gen, 40, "fuzyz/.");
+        const int full = smithWaterman("fuzzy", line) - levenshteinDistance("fuzzy", line);
+        EXPECT_EQ(query.score(line), std::max(full, 0)) << line;
+    }
+    // A line cut off for a query stays accepted, so that it is scored again when the query grows.
+    CompiledQuery shortQuery("f", Scorer::SmithWatermanLevenshtein);
+    const std::string line = "src/fuzzy";
+    EXPECT_EQ(shortQuery.score(line, CharMask::fromString(line)), 0);
+    EXPECT_GT(CompiledQuery("fuzzy", Scorer::SmithWatermanLevenshtein).score(line), 0);
+    EXPECT_EQ(CompiledQuery("", Scorer::SmithWatermanLevenshtein).score("abc"), 1);
+    EXPECT_EQ(parseScorer("smith-waterman-levenshtein"), Scorer::SmithWatermanLevenshtein);
+    EXPECT_THROW(parseScorer("bogus"), std::invalid_argument);
+}
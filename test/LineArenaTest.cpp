@@ -0,0 +1,51 @@
+// @file LineArenaTest.cpp
+// @brief Unit tests for the LineArena holding the lines read.
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "LineArena.h"
+using namespace fzf;
+
+TEST(LineArenaTest, StoresLinesBackToBack)
+{
+    LineArena arena;
+    EXPECT_EQ(arena.size(), 0u);
+    EXPECT_EQ(arena.append("/usr/bin"), 0u);
+    EXPECT_EQ(arena.append(""), 1u);
+    EXPECT_EQ(arena.append("/etc"), 2u);
+    ASSERT_EQ(arena.size(), 3u);
+    EXPECT_EQ(arena[0], "/usr/bin");
+    EXPECT_EQ(arena[1], "");
+    EXPECT_EQ(arena[2], "/etc");
+    EXPECT_EQ(arena.length(2), 4u);
+}
+
+TEST(LineArenaTest, ViewsStayValidAsTheArenaGrows)
+{
+    LineArena arena;
+    std::vector<std::string_view> views;
+    for (int i = 0; i < 100000; ++i)
+    {
+        views.push_back(arena[arena.append("/line/" + std::to_string(i))]);
+    }
+    // A line longer than a block gets a block of its own.
+    const std::string longLine(3 << 20, 'x');
+    views.push_back(arena[arena.append(longLine)]);
+    for (int i = 0; i < 100000; ++i)
+    {
+        ASSERT_EQ(views[i], "/line/" + std::to_string(i)) << i;
+        ASSERT_EQ(views[i].data(), arena[i].data()) << i;
+    }
+    EXPECT_EQ(views.back(), longLine);
+    EXPECT_GE(arena.bytes(), longLine.size() + arena.size() * 12);
+
+    // Adopted lines are not copied.
+    const std::string borrowed = "/borrowed";
+    const std::size_t index = arena.adopt(borrowed);
+    EXPECT_EQ(arena[index].data(), borrowed.data());
+    EXPECT_EQ(arena.length(index), borrowed.size());
+}
@@ -0,0 +1,51 @@
+// @file QueryCacheTest.cpp
+// @brief Unit tests for the per-query QueryCache.
+
+#include <gtest/gtest.h>
+
+#include "CompiledQuery.h"
+#include "QueryCache.h"
+#include "Ranking.h"
+#include "TestLines.h"
+using namespace fzf;
+using namespace fzf::test;
+
+TEST(QueryCacheTest, EvictsLeastRecentlyUsed)
+{
+    Ranking ranking;
+    for (const auto& path : randomPaths(1000, 7))
+    {
+        ranking.add(makeCandidate(CompiledQuery(""), path));
+    }
+    const std::size_t entryBytes = ranking.snapshot().bytes();
+
+    // Room for two snapshots of every line.
+    QueryCache cache(2 * entryBytes + 64);
+    cache.put("a", ranking.snapshot());
+    cache.put("b", ranking.snapshot());
+    ASSERT_NE(cache.get("a"), nullptr);  // "b" is now the least recently used
+    cache.put("c", ranking.snapshot());
+    EXPECT_EQ(cache.size(), 2u);
+    EXPECT_NE(cache.get("a"), nullptr);
+    EXPECT_EQ(cache.get("b"), nullptr);
+    EXPECT_NE(cache.get("c"), nullptr);
+    EXPECT_LE(cache.bytes(), 2 * entryBytes + 64);
+
+    // Replacing an entry does not count it twice; an entry over budget is not stored.
+    cache.put("c", ranking.snapshot());
+    EXPECT_EQ(cache.size(), 2u);
+    QueryCache disabled(0);
+    disabled.put("a", ranking.snapshot());
+    EXPECT_EQ(disabled.get("a"), nullptr);
+
+    // wants() tells whether taking a snapshot is worth it.
+    const std::size_t bytes = Ranking::Snapshot::bytesFor(ranking.acceptedCount());
+    EXPECT_LE(bytes, entryBytes);
+    EXPECT_FALSE(disabled.wants("a", ranking.size(), bytes));
+    EXPECT_FALSE(cache.wants("a", ranking.size(), bytes));  // Cached, no line added since
+    EXPECT_TRUE(cache.wants("a", ranking.size() + 1, bytes));
+    EXPECT_TRUE(cache.wants("d", ranking.size(), bytes));
+    cache.put("d", ranking.snapshot());  // "c" was the least recently used: wants("a") touched "a"
+    EXPECT_NE(cache.get("a"), nullptr);
+    EXPECT_EQ(cache.get("c"), nullptr);
+}
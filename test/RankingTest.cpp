@@ -0,0 +1,384 @@
+// @file RankingTest.cpp
+// @brief Unit tests for the partially ordered fzf::Ranking.
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "CompiledQuery.h"
+#include "Ranking.h"
+#include "TestLines.h"
+#include "ThreadPool.h"
+using namespace fzf;
+using namespace fzf::test;
+
+namespace {
+/// Checks the region invariants, and that the ordered prefix equals the top of a full sort.
+void expectConsistent(const Ranking& ranking, std::vector<Candidate> all)
+{
+    ASSERT_EQ(ranking.size(), all.size());
+    std::stable_sort(all.begin(), all.end(), rankedBefore);
+    auto matches = std::count_if(all.begin(), all.end(), [](auto& c) { return c.score > 0; });
+    auto accepted = std::count_if(all.begin(), all.end(),
+                                  [](auto& c) { return c.score != CompiledQuery::kNoMatch; });
+    ASSERT_EQ(ranking.matchCount(), static_cast<std::size_t>(matches));
+    ASSERT_EQ(ranking.acceptedCount(), static_cast<std::size_t>(accepted));
+    for (std::size_t i = 0; i < ranking.acceptedCount(); ++i)
+    {
+        EXPECT_EQ(ranking.score(i) > 0, i < ranking.matchCount()) << i;
+        EXPECT_NE(ranking.score(i), CompiledQuery::kNoMatch) << i;
+        EXPECT_EQ(ranking.position(ranking.id(i)), i) << i;
+    }
+    std::size_t rejected = 0;
+    for (Ranking::Id id = 0; id < ranking.size(); ++id)
+    {
+        rejected += ranking.position(id) == ranking.acceptedCount();
+    }
+    EXPECT_EQ(rejected, ranking.size() - ranking.acceptedCount());
+    for (std::size_t i = 0; i < ranking.orderedCount(); ++i)
+    {
+        // Ties may be ordered either way; compare the sort keys.
+        EXPECT_EQ(ranking.score(i), all[i].score) << i;
+        EXPECT_EQ(ranking.line(i).size(), all[i].line.size()) << i;
+    }
+}
+}  // namespace
+
+TEST(RankingTest, RescoreOrdersOnlyTheVisiblePrefix)
+{
+    auto paths = randomPaths(2000, 1);
+    CompiledQuery query("abc");
+    Ranking ranking;
+    std::vector<Candidate> all;
+    for (const auto& path : paths)
+    {
+        all.push_back(makeCandidate(CompiledQuery(""), path));
+        ranking.add(all.back());
+    }
+
+    ranking.rescore(query, 20);
+    for (auto& candidate : all)
+    {
+        candidate.score = query.score(candidate.line, candidate.mask);
+    }
+    EXPECT_EQ(ranking.orderedCount(), std::min<std::size_t>(20, ranking.matchCount()));
+    expectConsistent(ranking, all);
+
+    // Scrolling further orders more of the list.
+    ranking.ensureOrdered(100);
+    EXPECT_EQ(ranking.orderedCount(), std::min<std::size_t>(100, ranking.matchCount()));
+    expectConsistent(ranking, all);
+}
+
+TEST(RankingTest, AddKeepsOrderedPrefix)
+{
+    auto paths = randomPaths(3000, 2);
+    CompiledQuery query("ace");
+    Ranking ranking;
+    std::vector<Candidate> all;
+    for (const auto& path : paths)
+    {
+        all.push_back(makeCandidate(query, path));
+        ranking.add(all.back());
+        if (all.size() == 100)
+        {
+            ranking.ensureOrdered(10);
+        }
+    }
+    EXPECT_GT(ranking.orderedCount(), 0u);
+    expectConsistent(ranking, all);
+}
+
+TEST(RankingTest, FindOrdersUpToTheId)
+{
+    auto paths = randomPaths(500, 3);
+    CompiledQuery query("bad");
+    Ranking ranking;
+    for (const auto& path : paths)
+    {
+        ranking.add(makeCandidate(query, path));
+    }
+    ranking.rescore(query, 5);
+    ASSERT_GT(ranking.matchCount(), 50u);
+
+    // Pick a match that is not in the ordered prefix yet.
+    Ranking::Id id = ranking.id(ranking.matchCount() - 1);
+    std::size_t index = ranking.find(id);
+    ASSERT_LT(index, ranking.orderedCount());
+    EXPECT_EQ(ranking.id(index), id);
+    EXPECT_EQ(ranking.line(index), ranking.lineById(id));
+
+    // Lines the query rejects have no position.
+    ASSERT_LT(ranking.acceptedCount(), ranking.size());
+    for (Ranking::Id other = 0; other < ranking.size(); ++other)
+    {
+        if (ranking.position(other) == ranking.acceptedCount())
+        {
+            EXPECT_EQ(ranking.find(other), ranking.acceptedCount());
+            break;
+        }
+    }
+}
+
+TEST(RankingTest, MergeKeepsOrderedPrefix)
+{
+    auto paths = randomPaths(5000, 4);
+    CompiledQuery query("fad");
+    Ranking ranking;
+    std::vector<Candidate> all;
+    std::vector<Candidate> batch;
+    for (const auto& path : paths)
+    {
+        all.push_back(makeCandidate(query, path));
+        batch.push_back(all.back());
+        if (batch.size() == 300)
+        {
+            ranking.merge(std::move(batch));
+            batch.clear();
+            ranking.ensureOrdered(25);
+            expectConsistent(ranking, all);
+        }
+    }
+    ranking.merge(std::move(batch));
+    expectConsistent(ranking, all);
+}
+
+TEST(RankingTest, RefineMatchesFullRescore)
+{
+    auto paths = randomPaths(3000, 5);
+    Ranking refined;
+    Ranking rescored;
+    for (const auto& path : paths)
+    {
+        refined.add(makeCandidate(CompiledQuery(""), path));
+        rescored.add(makeCandidate(CompiledQuery(""), path));
+    }
+
+    std::string search;
+    for (char c : std::string("ab/c"))
+    {
+        search += c;
+        CompiledQuery query(search);
+        refined.refine(query, 30);
+        rescored.rescore(query, 30);
+        ASSERT_EQ(refined.acceptedCount(), rescored.acceptedCount()) << search;
+        ASSERT_EQ(refined.matchCount(), rescored.matchCount()) << search;
+        for (std::size_t i = 0; i < refined.orderedCount(); ++i)
+        {
+            EXPECT_EQ(refined.score(i), rescored.score(i)) << search << " " << i;
+        }
+    }
+    EXPECT_LT(refined.acceptedCount(), paths.size());
+}
+
+TEST(RankingTest, RestoreMatchesRescore)
+{
+    auto paths = randomPaths(4000, 6);
+    CompiledQuery first("abc");
+    CompiledQuery second("dh");
+    Ranking ranking;
+    std::vector<Candidate> all;
+    for (std::size_t i = 0; i < 3000; ++i)
+    {
+        all.push_back(makeCandidate(first, paths[i]));
+        ranking.add(all.back());
+    }
+    ranking.rescore(first, 20);
+    auto snapshot = ranking.snapshot();
+
+    // Switch to another query and read more lines before going back.
+    ranking.rescore(second, 20);
+    for (std::size_t i = 3000; i < paths.size(); ++i)
+    {
+        all.push_back(makeCandidate(second, paths[i]));
+        ranking.add(all.back());
+    }
+    ranking.restore(snapshot, first, 40);
+    for (auto& candidate : all)
+    {
+        candidate.score = first.score(candidate.line, candidate.mask);
+    }
+    EXPECT_EQ(ranking.orderedCount(), std::min<std::size_t>(40, ranking.matchCount()));
+    expectConsistent(ranking, all);
+}
+
+TEST(RankingTest, RemoveDropsCandidatesFromEveryRegion)
+{
+    auto paths = randomPaths(3000, 8);
+    CompiledQuery first("abc");
+    CompiledQuery second("dh");
+    Ranking ranking;
+    std::vector<Candidate> all;
+    for (const auto& path : paths)
+    {
+        all.push_back(makeCandidate(first, path));
+        ranking.add(all.back());
+    }
+    ranking.rescore(first, 20);
+    auto snapshot = ranking.snapshot();
+
+    // Every copy of a removed line goes; removed candidates are then checked as rejected ones.
+    std::vector<std::string_view> removed;
+    for (std::size_t i = 0; i < paths.size(); i += 3)
+    {
+        removed.push_back(paths[i]);
+    }
+    std::size_t expected = 0;
+    for (auto& candidate : all)
+    {
+        if (std::find(removed.begin(), removed.end(), candidate.line) != removed.end())
+        {
+            candidate.score = CompiledQuery::kNoMatch;
+            ++expected;
+        }
+    }
+    EXPECT_EQ(ranking.remove(removed), expected);
+    EXPECT_TRUE(ranking.removed(0));
+    EXPECT_EQ(ranking.remove(removed), 0u);
+    expectConsistent(ranking, all);
+
+    auto rescored = [&](const CompiledQuery& query)
+    {
+        for (auto& candidate : all)
+        {
+            if (candidate.score != CompiledQuery::kNoMatch ||
+                std::find(removed.begin(), removed.end(), candidate.line) == removed.end())
+            {
+                candidate.score = query.score(candidate.line, candidate.mask);
+            }
+        }
+    };
+    ranking.rescore(second, 20);
+    rescored(second);
+    expectConsistent(ranking, all);
+
+    // A snapshot taken before the removal does not bring the lines back.
+    ranking.restore(snapshot, first, 40);
+    rescored(first);
+    expectConsistent(ranking, all);
+
+    // A removed line added again gets the Id of one of its removed copies back.
+    ranking.add(makeCandidate(first, paths[0]));
+    EXPECT_FALSE(ranking.removed(0));
+    all[0].score = first.score(all[0].line, all[0].mask);
+    expectConsistent(ranking, all);
+}
+
+TEST(RankingTest, RemovedLinesAddedAgainDoNotGrowTheRanking)
+{
+    auto paths = randomPaths(2000, 10);
+    CompiledQuery query("ab");
+    Ranking ranking;
+    std::vector<Candidate> all;
+    for (const auto& path : paths)
+    {
+        all.push_back(makeCandidate(query, path));
+        ranking.add(all.back());
+    }
+    ranking.rescore(query, 20);
+
+    // A line rewritten over and over keeps its Id, whether it goes one at a time or in bulk.
+    for (int round = 0; round < 50; ++round)
+    {
+        std::vector<std::string_view> lines{paths[7], paths[1500]};
+        if (round % 10 == 0)
+        {
+            lines.assign(paths.begin(), paths.begin() + 1000);
+        }
+        ASSERT_EQ(ranking.remove(lines), lines.size());
+        std::vector<Candidate> batch;
+        for (std::string_view line : lines)
+        {
+            batch.push_back(Candidate{line, CharMask::fromString(line), 0});
+            batch.back().score = query.score(line, batch.back().mask);
+        }
+        ranking.merge(batch);
+        ASSERT_EQ(ranking.size(), paths.size());
+    }
+    ranking.ensureOrdered(20);
+    expectConsistent(ranking, all);
+
+    // A snapshot taken while lines were removed gets them back when restored, with their score.
+    CompiledQuery other("h");
+    std::vector<std::string_view> removed{paths[3], paths[4]};
+    ranking.remove(removed);
+    auto snapshot = ranking.snapshot();
+    ranking.add(makeCandidate(other, paths[3]));
+    ranking.add(makeCandidate(other, paths[4]));
+    ranking.rescore(other, 20);
+    ranking.restore(snapshot, query, 20);
+    expectConsistent(ranking, all);
+}
+
+TEST(RankingTest, ParallelScoringIsDeterministic)
+{
+    auto paths = randomPaths(30000, 8);
+    ThreadPool pool(4);
+    Ranking serial;
+    Ranking parallel(&pool);
+    std::vector<Candidate> all;
+    for (const auto& path : paths)
+    {
+        all.push_back(makeCandidate(CompiledQuery(""), path));
+        serial.add(all.back());
+        parallel.add(all.back());
+    }
+
+    std::string search;
+    for (char c : std::string("ab/c"))
+    {
+        search += c;
+        CompiledQuery query(search);
+        serial.refine(query, 50);
+        parallel.refine(query, 50);
+        ASSERT_EQ(serial.acceptedCount(), parallel.acceptedCount()) << search;
+        ASSERT_EQ(serial.orderedCount(), parallel.orderedCount()) << search;
+        for (std::size_t i = 0; i < serial.acceptedCount(); ++i)
+        {
+            ASSERT_EQ(serial.line(i), parallel.line(i)) << search << " " << i;
+            ASSERT_EQ(serial.score(i), parallel.score(i)) << search << " " << i;
+        }
+    }
+
+    CompiledQuery query("hag");
+    parallel.rescore(query, 50);
+    for (auto& candidate : all)
+    {
+        candidate.score = query.score(candidate.line, candidate.mask);
+    }
+    expectConsistent(parallel, all);
+}
+
+TEST(RankingTest, CancelledPassLeavesRankingUnchanged)
+{
+    auto paths = randomPaths(20000, 9);
+    ThreadPool pool(3);
+    Ranking ranking(&pool);
+    for (const auto& path : paths)
+    {
+        ranking.add(makeCandidate(CompiledQuery(""), path));
+    }
+    CompiledQuery first("ab");
+    ASSERT_TRUE(ranking.rescore(first, 20));
+    auto before = ranking.snapshot();
+
+    // Cancelled after a couple of chunks.
+    std::atomic<int> polls{0};
+    auto cancelled = [&]() { return ++polls > 2; };
+    EXPECT_FALSE(ranking.rescore(CompiledQuery("hg"), 20, cancelled));
+    EXPECT_FALSE(ranking.refine(CompiledQuery("ab/"), 20, cancelled));
+
+    auto after = ranking.snapshot();
+    ASSERT_EQ(after.accepted.size(), before.accepted.size());
+    EXPECT_EQ(after.matchCount, before.matchCount);
+    EXPECT_EQ(after.orderedCount, before.orderedCount);
+    for (std::size_t i = 0; i < after.accepted.size(); ++i)
+    {
+        EXPECT_EQ(after.accepted[i].id, before.accepted[i].id) << i;
+        EXPECT_EQ(after.accepted[i].score, before.accepted[i].score) << i;
+    }
+}
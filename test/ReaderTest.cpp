@@ -0,0 +1,772 @@
+// @file ReaderTest.cpp
+// @brief Unit tests for the input readers.
+
+#include <gtest/gtest.h>
+
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "BlockReader.h"
+#include "DirectoryWalker.h"
+#include "FileIndex.h"
+#include "FileListReader.h"
+#include "FileReader.h"
+#include "IgnoreRules.h"
+#include "LineSet.h"
+using namespace fzf;
+
+namespace {
+/// Runs reader to the end of its input and returns the lines it delivered.
+std::vector<std::string> readAll(Reader& reader)
+{
+    std::vector<std::string> lines;
+    bool ended = false;
+    reader.onUpdate = [&](Reader::ReadStatus status, Reader::Batch batch)
+    {
+        if (status == Reader::ReadStatus::EndOfFile)
+        {
+            ended = true;
+            return;
+        }
+        EXPECT_FALSE(batch.empty());
+        for (const auto& line : batch)
+        {
+            EXPECT_EQ(line.mask, CharMask::fromString(line.text));
+            lines.emplace_back(line.text);
+        }
+    };
+    reader.start();
+    EXPECT_TRUE(ended);
+    return lines;
+}
+
+std::string writeTempFile(const std::string& name, const std::string& contents)
+{
+    auto path = (std::filesystem::temp_directory_path() / name).string();
+    std::ofstream(path, std::ios::binary) << contents;
+    return path;
+}
+}  // namespace
+
+TEST(ReaderTest, FileReaderSplitsMappedFile)
+{
+    // No trailing newline, an empty line and a duplicate.
+    auto path = writeTempFile("fzf-reader-test.txt", "/usr/bin\n\n/etc\n/usr/bin\n/var/log");
+    FileReader reader(path);
+    EXPECT_EQ(readAll(reader), (std::vector<std::string>{"/usr/bin", "/etc", "/var/log"}));
+    std::remove(path.c_str());
+}
+
+TEST(ReaderTest, FileReaderStreamsSpecialFiles)
+{
+    auto empty = writeTempFile("fzf-reader-empty.txt", "");
+    FileReader emptyReader(empty);
+    EXPECT_TRUE(readAll(emptyReader).empty());
+    std::remove(empty.c_str());
+
+    FileReader device("/dev/null");
+    EXPECT_TRUE(readAll(device).empty());
+    EXPECT_THROW(FileReader("/nonexistent/fzf-reader-test"), std::runtime_error);
+}
+
+TEST(ReaderTest, BlockReaderJoinsLinesAcrossBlocks)
+{
+    // Lines cut by block boundaries, one longer than a block, and no trailing newline.
+    std::vector<std::string> expected;
+    std::string input;
+    for (std::size_t i = 0; input.size() < 3 * BlockReader::kBlockSize; ++i)
+    {
+        expected.push_back(std::string(1 + i % 97, 'a' + i % 26));
+        input += expected.back() + "\n";
+    }
+    expected.push_back(std::string(BlockReader::kBlockSize + 10, 'z'));
+    input += expected.back() + "\n";
+    expected.push_back("/last");
+    input += expected.back();
+
+    int fds[2];
+    ASSERT_EQ(pipe(fds), 0);
+    std::thread writer(
+        [&]()
+        {
+            for (std::size_t written = 0; written < input.size();)
+            {
+                ssize_t count = write(fds[1], input.data() + written, input.size() - written);
+                ASSERT_GT(count, 0);
+                written += count;
+            }
+            close(fds[1]);
+        });
+
+    std::vector<std::string> lines;
+    std::size_t batches = 0;
+    std::atomic<bool> stop{false};
+    EXPECT_TRUE(BlockReader(fds[0]).run(stop,
+                                        [&](BlockReader::Batch batch)
+                                        {
+                                            ++batches;
+                                            lines.insert(lines.end(), batch.begin(), batch.end());
+                                        }));
+    writer.join();
+    close(fds[0]);
+    EXPECT_EQ(lines, expected);
+    EXPECT_LT(batches, expected.size() / 100);  // Delivered in bulk, not line by line
+}
+
+TEST(ReaderTest, BlockReaderStopsWhileWaiting)
+{
+    int fds[2];
+    ASSERT_EQ(pipe(fds), 0);
+    ASSERT_EQ(write(fds[1], "a\nb", 3), 3);
+    std::atomic<bool> stop{false};
+    std::vector<std::string> lines;
+    std::thread stopper(
+        [&]()
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            stop = true;
+        });
+    auto collect = [&](BlockReader::Batch batch)
+    { lines.insert(lines.end(), batch.begin(), batch.end()); };
+    EXPECT_FALSE(BlockReader(fds[0]).run(stop, collect));
+    stopper.join();
+    close(fds[0]);
+    close(fds[1]);
+    EXPECT_EQ(lines, std::vector<std::string>{"a"});  // "b" is unfinished
+}
+
+TEST(ReaderTest, AddLineDeliversAtOnce)
+{
+    struct LineByLine : Reader
+    {
+        void start() override {}
+    } reader;
+
+    std::vector<std::string> lines;
+    reader.onUpdate = [&](Reader::ReadStatus, Reader::Batch batch)
+    {
+        for (const auto& line : batch)
+        {
+            lines.emplace_back(line.text);
+        }
+    };
+    // Nothing is held back waiting for more lines or the end of the input.
+    EXPECT_TRUE(reader.addLine("/a"));
+    EXPECT_EQ(lines, std::vector<std::string>{"/a"});
+    EXPECT_FALSE(reader.addLine("/a"));  // Duplicates are dropped
+    EXPECT_FALSE(reader.addLine(""));
+    EXPECT_TRUE(reader.addLine("/b"));
+    EXPECT_EQ(lines, (std::vector<std::string>{"/a", "/b"}));
+}
+
+TEST(ReaderTest, DisconnectedReaderNotifiesNobody)
+{
+    struct LineByLine : Reader
+    {
+        void start() override {}
+    } reader;
+
+    int notified = 0;
+    reader.onUpdate = [&](Reader::ReadStatus, Reader::Batch) { ++notified; };
+    reader.onRemove = [&](std::span<const std::string_view>) { ++notified; };
+    reader.disconnect();
+    // A reader finishing after its listener is gone carries on without it.
+    EXPECT_TRUE(reader.addLine("/a"));
+    std::string_view line = "/a";
+    EXPECT_EQ(reader.removeLines(std::span(&line, 1)), 1u);
+    EXPECT_NO_THROW(reader.setEndOfFile());
+    EXPECT_EQ(reader.status(), Reader::ReadStatus::EndOfFile);
+    EXPECT_EQ(notified, 0);
+}
+
+TEST(ReaderTest, LineSetKeepsDistinctLinesOnly)
+{
+    LineSet set;
+    const std::optional<std::string_view> stored = set.insert("/usr/bin");
+    ASSERT_TRUE(stored);
+    EXPECT_EQ(*stored, "/usr/bin");  // The set's own copy
+    EXPECT_FALSE(set.insert("/usr/bin"));
+    EXPECT_TRUE(set.insert("/usr/bin/"));
+    EXPECT_TRUE(set.insert(""));
+    EXPECT_FALSE(set.insert(""));
+    EXPECT_EQ(set.size(), 3u);
+    EXPECT_NE(hashLine("ab"), hashLine("ba"));
+    EXPECT_NE(hashLine(std::string(20, 'a')), hashLine(std::string(21, 'a')));
+
+    // Threads adding overlapping ranges, through several table growths.
+    constexpr std::size_t kLines = 200000;
+    std::vector<std::thread> threads;
+    std::atomic<std::size_t> added{0};
+    for (std::size_t t = 0; t < 4; ++t)
+    {
+        threads.emplace_back(
+            [&, t]()
+            {
+                for (std::size_t i = t * kLines / 8; i < t * kLines / 8 + kLines / 2; ++i)
+                {
+                    added += set.insert("/line/" + std::to_string(i)).has_value();
+                }
+            });
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+    const std::size_t distinct = 3 * kLines / 8 + kLines / 2;
+    EXPECT_EQ(added, distinct);
+    EXPECT_EQ(set.size(), distinct + 3);
+    // At most 32 bytes of table and 12 of arena per line (twice that for vector growth), plus
+    // the characters (twice that for block growth).
+    std::size_t characters = 0;
+    for (std::size_t i = 0; i < distinct; ++i)
+    {
+        characters += ("/line/" + std::to_string(i)).size();
+    }
+    EXPECT_LT(set.bytes(), (distinct + 3) * (32 + 2 * 12) + 2 * characters);
+    EXPECT_EQ(*stored, "/usr/bin");  // Still valid after every growth
+}
+
+TEST(ReaderTest, LineSetErasesLines)
+{
+    // Enough lines to fill long probe runs, which erasing must keep intact.
+    constexpr std::size_t kLines = 100000;
+    LineSet set;
+    for (std::size_t i = 0; i < kLines; ++i)
+    {
+        set.insert("/line/" + std::to_string(i));
+    }
+    for (std::size_t i = 0; i < kLines; i += 2)
+    {
+        EXPECT_TRUE(set.erase("/line/" + std::to_string(i)));
+        EXPECT_FALSE(set.erase("/line/" + std::to_string(i)));
+    }
+    EXPECT_FALSE(set.erase("/not/there"));
+    EXPECT_EQ(set.size(), kLines / 2);
+    for (std::size_t i = 0; i < kLines; ++i)
+    {
+        // Odd lines are still there, even ones are added again.
+        EXPECT_EQ(set.insert("/line/" + std::to_string(i)).has_value(), i % 2 == 0) << i;
+    }
+    EXPECT_EQ(set.size(), kLines);
+
+    // A line erased and added again gets its copy back, and the set does not grow.
+    const std::string_view stored = *set.insert("/again");
+    const std::size_t bytes = set.bytes();
+    for (int round = 0; round < 1000; ++round)
+    {
+        EXPECT_TRUE(set.erase("/again"));
+        EXPECT_EQ(set.insert("/again")->data(), stored.data());
+    }
+    EXPECT_EQ(set.bytes(), bytes);
+    EXPECT_EQ(set.size(), kLines + 1);
+}
+
+TEST(ReaderTest, RemovedLinesCanBeAddedAgain)
+{
+    struct Lines : Reader
+    {
+        void start() override {}
+    } reader;
+    std::vector<std::string> added;
+    std::vector<std::string> removed;
+    reader.onUpdate = [&](Reader::ReadStatus, Reader::Batch batch)
+    {
+        for (const auto& line : batch)
+        {
+            added.emplace_back(line.text);
+        }
+    };
+    reader.onRemove = [&](std::span<const std::string_view> lines)
+    { removed.insert(removed.end(), lines.begin(), lines.end()); };
+
+    std::vector<std::string_view> lines{"/a", "/b"};
+    reader.addLines(lines);
+    std::vector<std::string_view> gone{"/a", "/c"};
+    EXPECT_EQ(reader.removeLines(gone), 1u);
+    EXPECT_EQ(removed, (std::vector<std::string>{"/a"}));
+    EXPECT_EQ(reader.seenCount(), 1u);
+    reader.addLines(lines);
+    EXPECT_EQ(added, (std::vector<std::string>{"/a", "/b", "/a"}));
+}
+
+TEST(ReaderTest, DeduplicationCanBeDisabled)
+{
+    auto path = writeTempFile("fzf-reader-dups.txt", "/a\n/b\n/a\n");
+    FileReader reader(path);
+    reader.setDeduplicate(false);
+    EXPECT_EQ(readAll(reader), (std::vector<std::string>{"/a", "/b", "/a"}));
+    EXPECT_EQ(reader.seenCount(), 3u);
+    std::remove(path.c_str());
+}
+
+TEST(ReaderTest, DirectoryWalkerListsTreeInParallel)
+{
+    namespace fs = std::filesystem;
+    const fs::path root = fs::temp_directory_path() / "fzf-walker-test";
+    fs::remove_all(root);
+    std::set<std::string> files;
+    std::set<std::string> directories;
+    for (int a = 0; a < 5; ++a)
+    {
+        for (int b = 0; b < 40; ++b)
+        {
+            fs::path dir = root / ("a" + std::to_string(a)) / ("b" + std::to_string(b));
+            fs::create_directories(dir);
+            std::ofstream(dir / "file.txt") << "x";
+            files.insert((dir / "file.txt").string());
+            directories.insert(dir.string());
+        }
+        directories.insert((root / ("a" + std::to_string(a))).string());
+    }
+    // Neither version control metadata nor the targets of links are entered.
+    fs::create_directories(root / ".git" / "objects");
+    std::ofstream(root / ".git" / "HEAD") << "x";
+    fs::create_directory_symlink(root / "a0", root / "link-dir");
+    fs::create_symlink(root / "a0" / "b0" / "file.txt", root / "link-file");
+    directories.insert((root / "link-dir").string());
+    files.insert((root / "link-file").string());
+
+    auto list = [&](DirectoryWalker::Select select)
+    {
+        std::mutex mutex;
+        std::set<std::string> listed;
+        std::atomic<bool> stop{false};
+        DirectoryWalker(root.string(), select, 4)
+            .run(stop,
+                 [&](std::span<const std::string_view> paths)
+                 {
+                     std::scoped_lock lock(mutex);
+                     for (auto path : paths)
+                     {
+                         EXPECT_TRUE(listed.emplace(path).second) << path;
+                     }
+                 });
+        return listed;
+    };
+    EXPECT_EQ(list(DirectoryWalker::Select::Files), files);
+    EXPECT_EQ(list(DirectoryWalker::Select::Directories), directories);
+
+    FileListReader reader(root.string(), FileListReader::SearchType::Files, 3);
+    std::mutex mutex;
+    std::set<std::string> read;
+    std::atomic<bool> ended{false};
+    reader.onUpdate = [&](Reader::ReadStatus status, Reader::Batch batch)
+    {
+        std::scoped_lock lock(mutex);
+        ended = status == Reader::ReadStatus::EndOfFile;
+        for (const auto& line : batch)
+        {
+            read.emplace(line.text);
+        }
+    };
+    reader.start();
+    while (!ended)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    reader.stop();
+    EXPECT_EQ(read, files);
+    fs::remove_all(root);
+}
+
+TEST(ReaderTest, IgnoreRulesFollowGitignoreSyntax)
+{
+    EXPECT_TRUE(globMatch("*.o", "main.o"));
+    EXPECT_FALSE(globMatch("*.o", "src/main.o"));
+    EXPECT_TRUE(globMatch("src/*.[ch]", "src/main.c"));
+    EXPECT_FALSE(globMatch("src/*.[!ch]", "src/main.c"));
+    EXPECT_TRUE(globMatch("**/build", "a/b/build"));
+    EXPECT_TRUE(globMatch("**/build", "build"));
+    EXPECT_TRUE(globMatch("a/**/z", "a/z"));
+    EXPECT_TRUE(globMatch("a/**/z", "a/b/c/z"));
+    EXPECT_TRUE(globMatch("a/**", "a/b/c"));
+    EXPECT_FALSE(globMatch("a/**", "a"));
+    EXPECT_TRUE(globMatch("\\*", "*"));
+    EXPECT_TRUE(globMatch("[", "["));
+
+    IgnoreRules rules;
+    rules.parse("# comment\n"
+                "*.log\n"
+                "!keep.log\n"
+                "build/\n"
+                "/top\n"
+                "docs/*.tmp   \n"
+                "\\#literal\n");
+    using Match = IgnoreRules::Match;
+    EXPECT_EQ(rules.match("a/b/debug.log", false), Match::Ignored);
+    EXPECT_EQ(rules.match("a/keep.log", false), Match::Included);
+    EXPECT_EQ(rules.match("x/build", true), Match::Ignored);
+    EXPECT_EQ(rules.match("x/build", false), Match::None);  // Directories only
+    EXPECT_EQ(rules.match("top", true), Match::Ignored);
+    EXPECT_EQ(rules.match("x/top", true), Match::None);  // Anchored
+    EXPECT_EQ(rules.match("docs/a.tmp", false), Match::Ignored);
+    EXPECT_EQ(rules.match("x/docs/a.tmp", false), Match::None);
+    EXPECT_EQ(rules.match("#literal", false), Match::Ignored);
+    EXPECT_EQ(rules.match("src/main.c", false), Match::None);
+}
+
+TEST(ReaderTest, DirectoryWalkerPrunesIgnoredPaths)
+{
+    namespace fs = std::filesystem;
+    const fs::path root = fs::temp_directory_path() / "fzf-ignore-test";
+    fs::remove_all(root);
+    auto write = [&](const fs::path& path, const std::string& contents)
+    {
+        fs::create_directories((root / path).parent_path());
+        std::ofstream(root / path) << contents;
+    };
+    write("config/git/ignore", "*.global\n");
+    write("repo/.git/info/exclude", "*.excluded\n");
+    write("repo/.gitignore", "build/\n*.log\n/src/anchored\n");
+    write("repo/src/.gitignore", "!important.log\ngenerated.c\n");
+    write("repo/src/.ignore", "*.tmp\n");
+    for (const char* file : {"repo/main.c", "repo/a.log", "repo/b.excluded", "repo/c.global",
+                             "repo/build/out.o", "repo/src/build/out.o", "repo/src/util.c",
+                             "repo/src/important.log", "repo/src/other.log", "repo/src/generated.c",
+                             "repo/src/x.tmp", "repo/lib/generated.c", "repo/src/anchored",
+                             "repo/src/d.excluded"})
+    {
+        write(file, "x");
+    }
+    ::setenv("XDG_CONFIG_HOME", (root / "config").c_str(), 1);
+
+    auto list = [&](bool ignoreFiles, const std::string& directory = "repo")
+    {
+        std::mutex mutex;
+        std::set<std::string> listed;
+        std::atomic<bool> stop{false};
+        DirectoryWalker((root / directory).string(), DirectoryWalker::Select::Files, 2, ignoreFiles)
+            .run(stop,
+                 [&](std::span<const std::string_view> paths)
+                 {
+                     std::scoped_lock lock(mutex);
+                     for (auto path : paths)
+                     {
+                         listed.emplace(path.substr((root / directory).string().size() + 1));
+                     }
+                 });
+        return listed;
+    };
+    EXPECT_EQ(list(true), (std::set<std::string>{".gitignore", "main.c", "src/.gitignore",
+                                                 "src/.ignore", "src/util.c", "src/important.log",
+                                                 "lib/generated.c"}));
+    EXPECT_EQ(list(false).size(), 17u);
+    // Below the top level, the ignore files above the root and .git/info/exclude still apply.
+    EXPECT_EQ(list(true, "repo/src"),
+              (std::set<std::string>{".gitignore", ".ignore", "util.c", "important.log"}));
+    EXPECT_EQ(list(false, "repo/src").size(), 10u);
+    ::unsetenv("XDG_CONFIG_HOME");
+    fs::remove_all(root);
+}
+
+TEST(ReaderTest, FileIndexRevalidatesChangedDirectories)
+{
+    namespace fs = std::filesystem;
+    const fs::path root = fs::temp_directory_path() / "fzf-index-test";
+    fs::remove_all(root);
+    for (const char* file : {"tree/a/1", "tree/a/2", "tree/b/c/3"})
+    {
+        fs::create_directories((root / file).parent_path());
+        std::ofstream(root / file) << "x";
+    }
+    // Directories modified in the second they are read in are never trusted; these are older.
+    const auto old = fs::file_time_type::clock::now() - std::chrono::hours(1);
+    for (const char* directory : {"tree", "tree/a", "tree/b", "tree/b/c"})
+    {
+        fs::last_write_time(root / directory, old);
+    }
+    const std::string tree = (root / "tree").string();
+    const std::string path = (root / "cache" / "tree.index").string();
+
+    auto walk = [&](const FileIndex* previous, FileIndex::Writer& next)
+    {
+        std::mutex mutex;
+        std::set<std::string> listed;
+        std::atomic<bool> stop{false};
+        DirectoryWalker walker(tree, DirectoryWalker::Select::Files, 2, false);
+        walker.setIndex(previous, &next);
+        walker.run(stop,
+                   [&](std::span<const std::string_view> paths)
+                   {
+                       std::scoped_lock lock(mutex);
+                       for (auto path : paths)
+                       {
+                           listed.emplace(path.substr(tree.size() + 1));
+                       }
+                   });
+        return listed;
+    };
+    auto list = [&](const FileIndex& index)
+    {
+        std::set<std::string> listed;
+        index.list(
+            [&](std::span<const std::string_view> paths)
+            {
+                for (auto path : paths)
+                {
+                    listed.emplace(path.substr(tree.size() + 1));
+                }
+            },
+            2);
+        return listed;
+    };
+
+    FileIndex::Writer first;
+    EXPECT_EQ(walk(nullptr, first), (std::set<std::string>{"a/1", "a/2", "b/c/3"}));
+    ASSERT_TRUE(first.save(path, "key"));
+    EXPECT_TRUE(FileIndex::load(path, "other key").empty());
+    FileIndex index = FileIndex::load(path, "key");
+    EXPECT_EQ(index.size(), 4u);
+    EXPECT_EQ(list(index), (std::set<std::string>{"a/1", "a/2", "b/c/3"}));
+
+    // A file added to a: a is read again and only the new file is listed.  One slipped into b/c
+    // without its time changing is not seen, which shows that b/c was replayed from the index.
+    std::ofstream(root / "tree/a/4") << "x";
+    std::ofstream(root / "tree/b/c/5") << "x";
+    fs::last_write_time(root / "tree/b/c", old);
+    FileIndex::Writer second;
+    EXPECT_EQ(walk(&index, second), (std::set<std::string>{"a/4"}));
+    ASSERT_TRUE(second.save(path, "key"));
+    EXPECT_EQ(list(FileIndex::load(path, "key")),
+              (std::set<std::string>{"a/1", "a/2", "a/4", "b/c/3"}));
+
+    // A truncated index is not used.
+    fs::resize_file(path, fs::file_size(path) - 1);
+    EXPECT_TRUE(FileIndex::load(path, "key").empty());
+    fs::remove_all(root);
+}
+
+TEST(ReaderTest, FileIndexRevalidatesEditedIgnoreFiles)
+{
+    namespace fs = std::filesystem;
+    const fs::path root = fs::temp_directory_path() / "fzf-index-ignore-test";
+    fs::remove_all(root);
+    for (const char* file : {"tree/a/1.log", "tree/a/2.txt", "tree/b/3.txt"})
+    {
+        fs::create_directories((root / file).parent_path());
+        std::ofstream(root / file) << "x";
+    }
+    fs::create_directories(root / "config/git");
+    std::ofstream(root / "config/git/ignore") << "";
+    std::ofstream(root / "tree/.gitignore") << "*.log\n";
+    // Nothing is modified in the second it is read in, which would have it read again anyway.
+    // Editing a file in place leaves the time of its directory as it is.
+    const auto old = fs::file_time_type::clock::now() - std::chrono::hours(1);
+    for (const char* directory : {"tree", "tree/a", "tree/b"})
+    {
+        fs::last_write_time(root / directory, old);
+    }
+    auto age = [&](const char* file, int minutes)
+    { fs::last_write_time(root / file, old + std::chrono::minutes(minutes)); };
+    age("config/git/ignore", 0);
+    age("tree/.gitignore", 0);
+    ::setenv("XDG_CONFIG_HOME", (root / "config").c_str(), 1);
+
+    const std::string tree = (root / "tree").string();
+    auto walk = [&](const FileIndex* previous, FileIndex::Writer& next)
+    {
+        std::mutex mutex;
+        std::set<std::string> listed;
+        std::set<std::string> removed;
+        std::atomic<bool> stop{false};
+        auto into = [&](std::set<std::string>& paths)
+        {
+            return [&](std::span<const std::string_view> batch)
+            {
+                std::scoped_lock lock(mutex);
+                for (auto path : batch)
+                {
+                    paths.emplace(path.substr(tree.size() + 1));
+                }
+            };
+        };
+        DirectoryWalker walker(tree, DirectoryWalker::Select::Files, 2, true);
+        walker.setIndex(previous, &next);
+        walker.run(stop, into(listed), into(removed));
+        return std::make_pair(listed, removed);
+    };
+    using Paths = std::set<std::string>;
+    const std::string path = (root / "cache/tree.index").string();
+    auto save = [&](const FileIndex::Writer& writer)
+    {
+        EXPECT_TRUE(writer.save(path, "key"));
+        return FileIndex::load(path, "key");
+    };
+
+    FileIndex::Writer first;
+    EXPECT_EQ(walk(nullptr, first),
+              std::make_pair(Paths{".gitignore", "a/2.txt", "b/3.txt"}, Paths{}));
+    FileIndex index = save(first);
+
+    // The root's .gitignore edited in place, its directory unchanged: the directories below it,
+    // unchanged too, are read again with the new patterns.
+    std::ofstream(root / "tree/.gitignore") << "*.txt\n";
+    age("tree/.gitignore", 1);
+    FileIndex::Writer second;
+    EXPECT_EQ(walk(&index, second), std::make_pair(Paths{"a/1.log"}, Paths{"a/2.txt", "b/3.txt"}));
+    index = save(second);
+
+    // Nothing changed: everything is replayed.
+    FileIndex::Writer third;
+    EXPECT_EQ(walk(&index, third), std::make_pair(Paths{}, Paths{}));
+    index = save(third);
+
+    // The global excludes file edited: the whole tree is read again.
+    std::ofstream(root / "config/git/ignore") << "1.log\n";
+    age("config/git/ignore", 1);
+    FileIndex::Writer fourth;
+    EXPECT_EQ(walk(&index, fourth), std::make_pair(Paths{}, Paths{"a/1.log"}));
+
+    ::unsetenv("XDG_CONFIG_HOME");
+    fs::remove_all(root);
+}
+
+TEST(ReaderTest, FileListReaderRemovesStaleIndexEntries)
+{
+    namespace fs = std::filesystem;
+    const fs::path root = fs::temp_directory_path() / "fzf-stale-index-test";
+    fs::remove_all(root);
+    for (const char* file : {"tree/a/1", "tree/a/2", "tree/b/3", "tree/b/c/4", "tree/b/c/d/5"})
+    {
+        fs::create_directories((root / file).parent_path());
+        std::ofstream(root / file) << "x";
+    }
+    ::setenv("XDG_CACHE_HOME", (root / "cache").c_str(), 1);
+    const std::string tree = (root / "tree").string();
+
+    // The listing left once each line added has been taken away by the removals that follow.
+    auto read = [&]()
+    {
+        FileListReader reader(tree, FileListReader::SearchType::Files, 2, false, true);
+        std::mutex mutex;
+        std::multiset<std::string> listed;
+        std::atomic<bool> ended{false};
+        reader.onUpdate = [&](Reader::ReadStatus status, Reader::Batch batch)
+        {
+            std::scoped_lock lock(mutex);
+            for (const auto& line : batch)
+            {
+                listed.emplace(line.text.substr(tree.size() + 1));
+            }
+            ended = status == Reader::ReadStatus::EndOfFile;
+        };
+        reader.onRemove = [&](std::span<const std::string_view> lines)
+        {
+            std::scoped_lock lock(mutex);
+            for (auto line : lines)
+            {
+                auto it = listed.find(std::string(line.substr(tree.size() + 1)));
+                ASSERT_NE(it, listed.end()) << line;
+                listed.erase(it);
+            }
+        };
+        reader.start();
+        while (!ended)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        reader.stop();
+        return listed;
+    };
+    EXPECT_EQ(read(), (std::multiset<std::string>{"a/1", "a/2", "b/3", "b/c/4", "b/c/d/5"}));
+
+    // The second run lists the index first; the file and the directory deleted since are then
+    // removed, the files below the directory included.
+    fs::remove(root / "tree/a/1");
+    fs::remove_all(root / "tree/b/c");
+    EXPECT_EQ(read(), (std::multiset<std::string>{"a/2", "b/3"}));
+    EXPECT_EQ(read(), (std::multiset<std::string>{"a/2", "b/3"}));
+    ::unsetenv("XDG_CACHE_HOME");
+    fs::remove_all(root);
+}
+
+TEST(ReaderTest, DirectoryWalkerFollowsChanges)
+{
+    namespace fs = std::filesystem;
+    const fs::path root = fs::temp_directory_path() / "fzf-watch-test";
+    fs::remove_all(root);
+    auto touch = [&](const fs::path& path)
+    {
+        fs::create_directories((root / path).parent_path());
+        std::ofstream(root / path) << "x";
+    };
+    touch("keep/1");
+    touch("old/2");
+    touch("old/deep/3");
+    std::ofstream(root / ".gitignore") << "*.o\n";
+
+    std::mutex mutex;
+    std::set<std::string> listed;
+    auto add = [&](std::span<const std::string_view> paths)
+    {
+        std::scoped_lock lock(mutex);
+        for (auto path : paths)
+        {
+            listed.emplace(path.substr(root.string().size() + 1));
+        }
+    };
+    auto remove = [&](std::span<const std::string_view> paths)
+    {
+        std::scoped_lock lock(mutex);
+        for (auto path : paths)
+        {
+            listed.erase(std::string(path.substr(root.string().size() + 1)));
+        }
+    };
+    // Waits for the listing to settle on the expected one.
+    auto expectListed = [&](const std::set<std::string>& expected)
+    {
+        for (int i = 0; i < 200; ++i)
+        {
+            {
+                std::scoped_lock lock(mutex);
+                if (listed == expected)
+                {
+                    break;
+                }
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        std::scoped_lock lock(mutex);
+        EXPECT_EQ(listed, expected);
+    };
+
+    DirectoryWalker walker(root.string(), DirectoryWalker::Select::Files, 2);
+    ASSERT_TRUE(walker.setWatch(true));
+    std::atomic<bool> stop{false};
+    walker.run(stop, add);
+    expectListed({".gitignore", "keep/1", "old/2", "old/deep/3"});
+    std::thread watching([&]() { walker.watch(stop, add, remove); });
+
+    // Files created, ignored and deleted.
+    touch("keep/4");
+    touch("keep/5.o");
+    fs::remove(root / "keep/1");
+    expectListed({".gitignore", "keep/4", "old/2", "old/deep/3"});
+
+    // A subtree moved within the tree, then one created and one deleted.
+    fs::rename(root / "old", root / "keep/moved");
+    expectListed({".gitignore", "keep/4", "keep/moved/2", "keep/moved/deep/3"});
+    fs::create_directories(root / "new/a/b");
+    touch("new/a/b/6");
+    expectListed({".gitignore", "keep/4", "keep/moved/2", "keep/moved/deep/3", "new/a/b/6"});
+    fs::remove_all(root / "keep");
+    expectListed({".gitignore", "new/a/b/6"});
+
+    stop = true;
+    watching.join();
+    fs::remove_all(root);
+}
@@ -0,0 +1,111 @@
+// @file ScoringBenchmark.cpp
+// @brief Measures how scoring a corpus scales with the number of threads.
+//
+// Usage: ScoringBenchmark [lines] [max threads]
+//
+// Rescores a synthetic corpus of file paths with 1, 2, 4, ... threads and prints the time per
+// pass and the speedup over one thread.  It also checks that every thread count produces the
+// same ranking.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "CompiledQuery.h"
+#include "Ranking.h"
+#include "ThreadPool.h"
+
+using namespace fzf;
+
+namespace {
+std::vector<std::string> corpus(std::size_t count)
+{
+    std::mt19937 gen(42);
+    std::vector<std::string> paths;
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        std::string path;
+        for (int part = 0; part < 5; ++part)
+        {
+            path += "/";
+            std::size_t length = 2 + gen() % 10;
+            for (std::size_t k = 0; k < length; ++k)
+            {
+                path += "abcdefghijklmnopqrstuvwxyz_."[gen() % 28];
+            }
+        }
+        paths.push_back(path);
+    }
+    return paths;
+}
+
+/// Best time of a few passes, in milliseconds.
+double timeRescore(Ranking& ranking, const CompiledQuery& query)
+{
+    double best = 1e30;
+    for (int pass = 0; pass < 5; ++pass)
+    {
+        auto start = std::chrono::steady_clock::now();
+        ranking.rescore(query, 50);
+        std::chrono::duration<double, std::milli> elapsed =
+            std::chrono::steady_clock::now() - start;
+        best = std::min(best, elapsed.count());
+    }
+    return best;
+}
+}  // namespace
+
+int main(int argc, char* argv[])
+{
+    const std::size_t lines = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+    const std::size_t maxThreads = argc > 2 ? std::strtoul(argv[2], nullptr, 10)
+                                            : std::max(1u, std::thread::hardware_concurrency());
+
+    const auto paths = corpus(lines);
+    const CompiledQuery empty;
+    const CompiledQuery query("ab/cd");
+    std::printf("%zu lines, query \"%s\", %u hardware threads\n", lines, query.query().c_str(),
+                std::thread::hardware_concurrency());
+
+    std::vector<std::string> reference;
+    double baseline = 0;
+    for (std::size_t threads = 1; threads <= maxThreads; threads *= 2)
+    {
+        ThreadPool pool(threads);
+        Ranking ranking(&pool);
+        for (const auto& path : paths)
+        {
+            auto mask = CharMask::fromString(path);
+            ranking.add(Candidate{path, mask, empty.score(path, mask)});
+        }
+
+        double ms = timeRescore(ranking, query);
+        if (threads == 1)
+        {
+            baseline = ms;
+        }
+
+        std::vector<std::string> top;
+        for (std::size_t i = 0; i < ranking.orderedCount(); ++i)
+        {
+            top.emplace_back(ranking.line(i));
+        }
+        if (threads == 1)
+        {
+            reference = top;
+        }
+        std::printf("%2zu threads: %8.2f ms  %6.2fx  %.1f M lines/s  %s\n", threads, ms,
+                    baseline / ms, lines / ms / 1000.0,
+                    top == reference ? "same ranking" : "RANKING DIFFERS");
+        if (top != reference)
+        {
+            return EXIT_FAILURE;
+        }
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,48 @@
+// @file TestLines.h
+// @brief Lines and candidates shared by the unit tests.
+
+#ifndef TESTLINES_H
+#define TESTLINES_H
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include "CompiledQuery.h"
+#include "Ranking.h"
+
+namespace fzf::test
+{
+
+/// Paths of three random components, the same for the same seed.
+inline std::vector<std::string> randomPaths(std::size_t count, unsigned seed)
+{
+    std::mt19937 gen(seed);
+    std::vector<std::string> paths;
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        std::string path;
+        for (int part = 0; part < 3; ++part)
+        {
+            path += "/";
+            std::size_t length = 1 + gen() % 8;
+            for (std::size_t k = 0; k < length; ++k)
+            {
+                path += "abcdefgh"[gen() % 8];
+            }
+        }
+        paths.push_back(path);
+    }
+    return paths;
+}
+
+/// A line scored for query; the candidate views line, which must outlive it.
+inline Candidate makeCandidate(const CompiledQuery& query, const std::string& line)
+{
+    auto mask = CharMask::fromString(line);
+    return Candidate{line, mask, query.score(line, mask)};
+}
+
+}  // namespace fzf::test
+
+#endif  // TESTLINES_H
@@ -0,0 +1,30 @@
+// @file ThreadPoolTest.cpp
+// @brief Unit tests for the ThreadPool scoring the ranking.
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <stdexcept>
+#include <vector>
+
+#include "ThreadPool.h"
+using namespace fzf;
+
+TEST(ThreadPoolTest, RunsEveryIndexOnce)
+{
+    ThreadPool pool(4);
+    std::vector<std::atomic<int>> runs(1000);
+    pool.parallelFor(runs.size(), [&](std::size_t i) { ++runs[i]; });
+    for (std::size_t i = 0; i < runs.size(); ++i)
+    {
+        EXPECT_EQ(runs[i], 1) << i;
+    }
+    auto fail = [](std::size_t i)
+    {
+        if (i == 7)
+        {
+            throw std::runtime_error("7");
+        }
+    };
+    EXPECT_THROW(pool.parallelFor(10, fail), std::runtime_error);
+}